@@ -0,0 +1,48 @@
+#--------------------------------------------------#
+#                                                  #
+# SIF: Simple Installer Framework                  #
+# Simply, an alternative to Qt Installer Framework #
+#                                                  #
+# Copyright © 2019 Simelo.Tech                        #
+#                                                  #
+# This project is under the GPLv3 license          #
+#                                                  #
+#--------------------------------------------------#
+
+# Sources of the installer, shared by the library and the tools that build it in
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+        $$PWD/bufferpool.cpp \
+        $$PWD/cancellationtoken.cpp \
+        $$PWD/checkpoint.cpp \
+        $$PWD/checksum.cpp \
+        $$PWD/componentset.cpp \
+        $$PWD/delta.cpp \
+        $$PWD/directorycache.cpp \
+        $$PWD/filelink.cpp \
+        $$PWD/filesync.cpp \
+        $$PWD/installer.cpp \
+        $$PWD/iouring.cpp \
+        $$PWD/journal.cpp \
+        $$PWD/manifest.cpp \
+        $$PWD/payload.cpp \
+        $$PWD/tracer.cpp
+
+HEADERS += \
+        $$PWD/bufferpool.h \
+        $$PWD/cancellationtoken.h \
+        $$PWD/checkpoint.h \
+        $$PWD/checksum.h \
+        $$PWD/componentset.h \
+        $$PWD/delta.h \
+        $$PWD/directorycache.h \
+        $$PWD/filelink.h \
+        $$PWD/filesync.h \
+        $$PWD/installer.h \
+        $$PWD/iouring.h \
+        $$PWD/journal.h \
+        $$PWD/manifest.h \
+        $$PWD/payload.h \
+        $$PWD/tracer.h
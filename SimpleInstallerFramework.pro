@@ -26,11 +26,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-SOURCES += \
-        installer.cpp
-
-HEADERS += \
-        installer.h
+include(SimpleInstallerFramework.pri)
 
 DISTFILES += \
     CHANGELOG.md \
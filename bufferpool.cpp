@@ -0,0 +1,95 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "bufferpool.h"
+
+//! BufferPool::Lease
+
+BufferPool::Lease::Lease(BufferPool &pool) : data(pool.acquire()), pool(pool)
+{
+}
+
+BufferPool::Lease::~Lease()
+{
+    pool.release(&data);
+}
+
+//! BufferPool
+
+void BufferPool::reset(int bufferCount, int bufferSize)
+{
+    QMutexLocker locker(&mutex);
+    freeSlots.acquire(freeSlots.available());
+    freeSlots.release(bufferCount);
+    if (bufferSize != size) {
+        freeBuffers.clear();
+    }
+    while (freeBuffers.size() > bufferCount) {
+        freeBuffers.removeLast();
+    }
+    freeBuffers.reserve(bufferCount);
+    count = bufferCount;
+    size = bufferSize;
+}
+
+int BufferPool::bufferCount() const
+{
+    return count;
+}
+
+int BufferPool::bufferSize() const
+{
+    return size;
+}
+
+void BufferPool::reserve()
+{
+    freeSlots.acquire();
+}
+
+bool BufferPool::tryReserve()
+{
+    return freeSlots.tryAcquire();
+}
+
+QByteArray BufferPool::takeBuffer()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (!freeBuffers.isEmpty()) {
+            return freeBuffers.takeLast();
+        }
+    }
+    QByteArray buffer;
+    buffer.reserve(size);
+    return buffer;
+}
+
+QByteArray BufferPool::acquire()
+{
+    reserve();
+    return takeBuffer();
+}
+
+void BufferPool::release(QByteArray *buffer)
+{
+    // Buffers replaced by smaller ones (e.g. chunks of memory-mapped payloads) are not worth keeping
+    if (buffer && buffer->capacity() >= size) {
+        QMutexLocker locker(&mutex);
+        if (freeBuffers.size() < count) {
+            buffer->reserve(size); // keeps the memory when resized to 0
+            buffer->resize(0);
+            freeBuffers.append(*buffer);
+        }
+    }
+    if (buffer) {
+        *buffer = QByteArray();
+    }
+    freeSlots.release();
+}
@@ -0,0 +1,57 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+
+// Fixed number of I/O buffers of the same size, shared by every extraction thread. Buffers are allocated the first
+// time they are needed and reused afterwards, so the memory used for I/O never grows beyond bufferCount * bufferSize.
+// Taking a slot blocks while every buffer is in use, which slows down the stages producing data (reading and
+// decompressing) until the ones consuming it (writing) catch up. Thread-safe.
+class BufferPool
+{
+public:
+    // Holds a buffer of the pool during the enclosing block
+    class Lease
+    {
+    public:
+        explicit Lease(BufferPool &pool);
+        ~Lease();
+
+        QByteArray data;
+
+    private:
+        BufferPool &pool;
+    };
+
+    void reset(int bufferCount, int bufferSize); // must not be called while buffers are in use
+
+    int bufferCount() const;
+    int bufferSize() const;
+
+    void reserve(); // takes a slot, waiting for one if needed
+    bool tryReserve();
+    QByteArray takeBuffer(); // empty buffer of a reserved slot, with at least bufferSize bytes of capacity
+    QByteArray acquire(); // reserve() and takeBuffer()
+    void release(QByteArray *buffer = nullptr); // gives the slot back, and the buffer for reuse
+
+private:
+    int count = 0;
+    int size = 0;
+    QSemaphore freeSlots;
+    QMutex mutex; // guards freeBuffers
+    QVector<QByteArray> freeBuffers;
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,63 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "cancellationtoken.h"
+
+void CancellationToken::reset()
+{
+    canceled.storeRelease(0);
+    paused.storeRelease(0);
+    wakeAll();
+}
+
+void CancellationToken::cancel()
+{
+    canceled.storeRelease(1);
+    paused.storeRelease(0);
+    wakeAll();
+}
+
+bool CancellationToken::isCanceled() const
+{
+    return canceled.loadAcquire();
+}
+
+void CancellationToken::pause()
+{
+    paused.storeRelease(1);
+}
+
+void CancellationToken::resume()
+{
+    paused.storeRelease(0);
+    wakeAll();
+}
+
+bool CancellationToken::isPaused() const
+{
+    return paused.loadAcquire();
+}
+
+bool CancellationToken::checkpoint()
+{
+    if (paused.loadAcquire()) {
+        QMutexLocker locker(&mutex);
+        while (paused.loadAcquire() && !canceled.loadAcquire()) {
+            resumed.wait(&mutex);
+        }
+    }
+    return !canceled.loadAcquire();
+}
+
+void CancellationToken::wakeAll()
+{
+    // Taking the mutex makes sure no stage is between checking the flags and waiting
+    QMutexLocker locker(&mutex);
+    resumed.wakeAll();
+}
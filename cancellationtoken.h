@@ -0,0 +1,43 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QWaitCondition>
+
+// Shared by every stage of an installation (scanning, copying, verifying), which call checkpoint() between blocks of
+// bounded size, so they stop soon after cancel() is called, even in the middle of a large file. The same checkpoints
+// wait while the token is paused. Checking costs a single atomic load while the token is not paused. Thread-safe.
+class CancellationToken
+{
+public:
+    void reset(); // neither canceled nor paused
+
+    void cancel(); // also ends the pause, so paused stages can stop
+    bool isCanceled() const;
+
+    void pause();
+    void resume();
+    bool isPaused() const;
+
+    bool checkpoint(); // waits while paused, returns false if canceled
+
+private:
+    QAtomicInt canceled = 0;
+    QAtomicInt paused = 0;
+    QMutex mutex; // pairs with resumed
+    QWaitCondition resumed;
+
+    void wakeAll();
+};
+
+#endif // CANCELLATIONTOKEN_H
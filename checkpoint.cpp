@@ -0,0 +1,291 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "checkpoint.h"
+#include "filesync.h"
+
+#include <QDir>
+
+namespace {
+const QByteArray checkpointHeader = "SIF checkpoint 1\n";
+const QByteArray sourceRecord = "source ";
+const QByteArray fileRecord = "file ";
+const QByteArray partialRecord = "partial ";
+const QByteArray createdRecord = "created ";
+}
+
+QString Checkpoint::checkpointPath(const QString &installationPath)
+{
+    return QDir::cleanPath(installationPath) + "/.sif-checkpoint";
+}
+
+bool Checkpoint::open(const QString &installationPath, const QString &source)
+{
+    rootPath = QDir::cleanPath(installationPath) + '/';
+    completeFiles.clear();
+    partialFiles.clear();
+    createdFiles.clear();
+    pendingFiles.clear();
+    lastError.clear();
+    if (source.contains('\n')) {
+        return fail(tr("Unsupported installation source: %1").arg(source));
+    }
+
+    file.setFileName(checkpointPath(installationPath));
+    resuming = file.exists();
+    if (resuming && !load(source)) {
+        return false;
+    }
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Unbuffered | (resuming ? QIODevice::Append : QIODevice::Truncate);
+    if (!file.open(mode)) {
+        return fail(file.errorString());
+    }
+    active = true;
+    clock.start();
+    lastFlush.storeRelease(0);
+    if (!resuming && !append(checkpointHeader + sourceRecord + source.toUtf8() + '\n')) {
+        file.close();
+        active = false;
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::isActive() const
+{
+    return active;
+}
+
+bool Checkpoint::isResuming() const
+{
+    return active && resuming;
+}
+
+bool Checkpoint::isComplete(const QString &path) const
+{
+    return completeFiles.contains(path);
+}
+
+qint64 Checkpoint::resumeOffset(const QString &path) const
+{
+    return partialFiles.value(path, 0);
+}
+
+bool Checkpoint::isCreated(const QString &path) const
+{
+    return createdFiles.contains(path);
+}
+
+void Checkpoint::recordFile(const QString &path, const QString &filePath)
+{
+    if (!active) {
+        return;
+    }
+    QMutexLocker locker(&pendingMutex);
+    pendingFiles << qMakePair(path, filePath.isEmpty() ? path : filePath);
+}
+
+bool Checkpoint::recordPartialFile(QFile &partialFile, const QString &path, qint64 offset)
+{
+    if (!active) {
+        return true;
+    }
+    if (!FileSync::syncFile(partialFile)) {
+        return fail(tr("Unable to write the file to the disk: %1").arg(partialFile.fileName()));
+    }
+    return append(partialRecord + QByteArray::number(offset) + ' ' + path.toUtf8() + '\n');
+}
+
+bool Checkpoint::recordCreatedFile(const QString &path)
+{
+    if (!active) {
+        return true;
+    }
+    if (!append(createdRecord + path.toUtf8() + '\n')) {
+        return false;
+    }
+    QMutexLocker locker(&fileMutex);
+    if (!FileSync::syncFile(file)) {
+        lastError = tr("Unable to write the file to the disk: %1").arg(file.fileName());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::flushIfDue()
+{
+    if (!active || clock.elapsed() - lastFlush.loadAcquire() < interval || !flushMutex.tryLock()) {
+        return true;
+    }
+    bool flushed = flushPending();
+    flushMutex.unlock();
+    return flushed;
+}
+
+bool Checkpoint::flush()
+{
+    if (!active) {
+        return true;
+    }
+    QMutexLocker locker(&flushMutex);
+    return flushPending();
+}
+
+bool Checkpoint::close()
+{
+    if (!active) {
+        return true;
+    }
+    bool flushed = flush();
+    QMutexLocker locker(&fileMutex);
+    bool synced = FileSync::syncFile(file); // the checkpoint survives a reboot too
+    file.close();
+    active = false;
+    if (flushed && !synced) {
+        lastError = tr("Unable to write the file to the disk: %1").arg(file.fileName());
+    }
+    return flushed && synced;
+}
+
+bool Checkpoint::remove()
+{
+    if (!active) {
+        return true;
+    }
+    {
+        QMutexLocker locker(&pendingMutex);
+        pendingFiles.clear();
+    }
+    QMutexLocker locker(&fileMutex);
+    file.close();
+    active = false;
+    if (file.exists() && !file.remove()) {
+        lastError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString Checkpoint::errorString() const
+{
+    return lastError;
+}
+
+bool Checkpoint::load(const QString &source)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(file.errorString());
+    }
+    QByteArray header = file.readLine();
+    QByteArray sourceLine = file.readLine();
+    if (!sourceLine.endsWith('\n')) {
+        // Interrupted before anything was recorded, the checkpoint starts over
+        file.close();
+        resuming = false;
+        return true;
+    } else if (header != checkpointHeader) {
+        file.close();
+        return fail(tr("Unsupported installation checkpoint: %1").arg(file.fileName()));
+    } else if (sourceLine != sourceRecord + source.toUtf8() + '\n') {
+        file.close();
+        return fail(tr("The installation path holds an interrupted installation of something else: %1").arg(rootPath));
+    }
+
+    qint64 validSize = file.pos();
+    while (!file.atEnd()) {
+        QByteArray record = file.readLine();
+        if (!record.endsWith('\n')) {
+            break; // the process died while writing this record
+        }
+        validSize = file.pos();
+        QByteArray value = record.mid(0, record.size() - 1);
+        if (value.startsWith(fileRecord)) {
+            QString path = QString::fromUtf8(value.mid(fileRecord.size()));
+            completeFiles.insert(path);
+            partialFiles.remove(path);
+        } else if (value.startsWith(partialRecord)) {
+            value = value.mid(partialRecord.size());
+            int separator = value.indexOf(' ');
+            bool isNumber = false;
+            qint64 offset = separator > 0 ? value.left(separator).toLongLong(&isNumber) : 0;
+            if (isNumber && offset > 0) {
+                partialFiles[QString::fromUtf8(value.mid(separator + 1))] = offset;
+            }
+        } else if (value.startsWith(createdRecord)) {
+            createdFiles.insert(QString::fromUtf8(value.mid(createdRecord.size())));
+        }
+    }
+    file.close();
+
+    // A torn record is cut off, so the next ones start on a line of their own
+    if (file.size() != validSize && !QFile::resize(file.fileName(), validSize)) {
+        return fail(file.errorString());
+    }
+    return true;
+}
+
+bool Checkpoint::flushPending()
+{
+    QList<QPair<QString, QString>> files;
+    {
+        QMutexLocker locker(&pendingMutex);
+        files.swap(pendingFiles);
+    }
+    lastFlush.storeRelease(clock.elapsed());
+    if (files.isEmpty()) {
+        return true;
+    }
+
+    // The records are only written once their files are on the disk, so they are never ahead of the data
+    if (!syncFiles(files)) {
+        QMutexLocker locker(&pendingMutex);
+        pendingFiles += files; // retried by the next flush
+        return false;
+    }
+    QByteArray records;
+    for (auto file : files) {
+        records += fileRecord + file.first.toUtf8() + '\n';
+    }
+    return append(records);
+}
+
+bool Checkpoint::append(const QByteArray &record)
+{
+    QMutexLocker locker(&fileMutex);
+    if (file.write(record) != record.size()) {
+        lastError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::syncFiles(const QList<QPair<QString, QString>> &files)
+{
+    // A single syncfs() writes every file of the installation back. Files out of it may be on other file systems
+    bool fileSystemSynced = FileSync::syncFileSystem(rootPath);
+    for (auto file : files) {
+        const QString &path = file.second;
+        bool outOfRoot = QDir::isAbsolutePath(path);
+        if (fileSystemSynced && !outOfRoot) {
+            continue;
+        }
+        QString filePath = outOfRoot ? path : rootPath + path;
+        if (!FileSync::syncPath(filePath)) {
+            return fail(tr("Unable to write the file to the disk: %1").arg(filePath));
+        }
+    }
+    return true;
+}
+
+bool Checkpoint::fail(const QString &error)
+{
+    QMutexLocker locker(&fileMutex);
+    lastError = error;
+    return false;
+}
@@ -0,0 +1,83 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+
+// Progress of a resumable installation, so an interrupted one (suspended, killed or lost to a reboot) continues where it
+// stopped instead of starting over. The checkpoint is an append-only text file in the installation path:
+//
+//   SIF checkpoint 1
+//   source <identity>          what is being installed, a checkpoint of another payload is not resumed
+//   file <path>                the file is complete
+//   partial <offset> <path>    the first <offset> bytes of the file are written, the last record of a path wins
+//   created <path>             the additional file is about to be created by this installation
+//
+// Paths are relative to the installation path, or absolute for files out of it. Completed files are kept in memory and
+// written in batches by flush(), once the file system holding them is synced, so a record never claims data the disk
+// may not have. Partial files are synced by their writer before they are recorded. Created files are recorded and synced
+// before they are written, so one left by an interrupted installation can be told from a file of the user. Thread-safe.
+class Checkpoint
+{
+    Q_DECLARE_TR_FUNCTIONS(Checkpoint)
+
+public:
+    static const qint64 interval = 5000; // ms between flushes, and between records of a file being written
+
+    static QString checkpointPath(const QString &installationPath);
+
+    bool open(const QString &installationPath, const QString &source); // resumes the checkpoint found there, if any
+    bool isActive() const;
+    bool isResuming() const;
+    bool isComplete(const QString &path) const;
+    qint64 resumeOffset(const QString &path) const; // 0 if nothing of the file can be kept
+    bool isCreated(const QString &path) const;
+    void recordFile(const QString &path, const QString &filePath = QString()); // filePath holds the data if not at path
+    bool recordPartialFile(QFile &file, const QString &path, qint64 offset); // syncs the file first
+    bool recordCreatedFile(const QString &path); // syncs the record
+    bool flushIfDue(); // does nothing if another thread is flushing
+    bool flush();
+    bool close(); // flushes the pending records, the checkpoint stays for the next installation
+    bool remove();
+    QString errorString() const;
+
+private:
+    QString rootPath; // installation path, ending with '/'
+    QFile file;
+    bool active = false;
+    bool resuming = false;
+    QSet<QString> completeFiles; // read from the checkpoint being resumed, not changed afterwards
+    QHash<QString, qint64> partialFiles; // same
+    QSet<QString> createdFiles; // same
+    QMutex pendingMutex; // guards pendingFiles
+    QList<QPair<QString, QString>> pendingFiles; // complete, but not recorded yet, with the files to sync first
+    QMutex flushMutex; // serializes flushes
+    QMutex fileMutex; // guards file and lastError
+    QElapsedTimer clock;
+    QAtomicInteger<qint64> lastFlush = 0; // ms of clock
+    QString lastError;
+
+    bool load(const QString &source);
+    bool flushPending(); // flushMutex must be locked
+    bool append(const QByteArray &record);
+    bool syncFiles(const QList<QPair<QString, QString>> &files);
+    bool fail(const QString &error);
+};
+
+#endif // CHECKPOINT_H
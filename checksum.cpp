@@ -0,0 +1,165 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "checksum.h"
+
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+const quint64 prime1 = Q_UINT64_C(0x9E3779B185EBCA87);
+const quint64 prime2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+const quint64 prime3 = Q_UINT64_C(0x165667B19E3779F9);
+const quint64 prime4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+const quint64 prime5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 read64(const char *data)
+{
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(data));
+}
+
+inline quint32 read32(const char *data)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data));
+}
+
+inline quint64 mixRound(quint64 accumulator, quint64 input)
+{
+    accumulator += input * prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+inline quint64 mergeRound(quint64 accumulator, quint64 value)
+{
+    accumulator ^= mixRound(0, value);
+    return accumulator * prime1 + prime4;
+}
+}
+
+Checksum::Checksum(quint64 seed) : seed(seed)
+{
+    reset();
+}
+
+void Checksum::reset()
+{
+    accumulators[0] = seed + prime1 + prime2;
+    accumulators[1] = seed + prime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - prime1;
+    totalLength = 0;
+    stripeLength = 0;
+}
+
+void Checksum::addData(const char *data, qint64 length)
+{
+    if (length <= 0) {
+        return;
+    }
+    totalLength += quint64(length);
+
+    // Complete the pending stripe first
+    if (stripeLength > 0) {
+        int missing = int(qMin<qint64>(sizeof(stripe) - stripeLength, length));
+        memcpy(stripe + stripeLength, data, size_t(missing));
+        stripeLength += missing;
+        data += missing;
+        length -= missing;
+        if (stripeLength < int(sizeof(stripe))) {
+            return;
+        }
+        consumeStripes(stripe, 1);
+        stripeLength = 0;
+    }
+
+    qint64 stripeCount = length / qint64(sizeof(stripe));
+    consumeStripes(data, stripeCount);
+    data += stripeCount * qint64(sizeof(stripe));
+    length -= stripeCount * qint64(sizeof(stripe));
+
+    if (length > 0) {
+        memcpy(stripe, data, size_t(length));
+        stripeLength = int(length);
+    }
+}
+
+void Checksum::consumeStripes(const char *data, qint64 stripeCount)
+{
+    // The four lanes are independent, so the compiler can keep them in flight at the same time
+    quint64 v1 = accumulators[0];
+    quint64 v2 = accumulators[1];
+    quint64 v3 = accumulators[2];
+    quint64 v4 = accumulators[3];
+    for (qint64 i = 0; i < stripeCount; i++, data += 32) {
+        v1 = mixRound(v1, read64(data));
+        v2 = mixRound(v2, read64(data + 8));
+        v3 = mixRound(v3, read64(data + 16));
+        v4 = mixRound(v4, read64(data + 24));
+    }
+    accumulators[0] = v1;
+    accumulators[1] = v2;
+    accumulators[2] = v3;
+    accumulators[3] = v4;
+}
+
+quint64 Checksum::result() const
+{
+    quint64 h;
+    if (totalLength >= sizeof(stripe)) {
+        h = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) + rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        h = mergeRound(h, accumulators[0]);
+        h = mergeRound(h, accumulators[1]);
+        h = mergeRound(h, accumulators[2]);
+        h = mergeRound(h, accumulators[3]);
+    } else {
+        h = seed + prime5;
+    }
+    h += totalLength;
+
+    const char *data = stripe;
+    int remaining = stripeLength;
+    while (remaining >= 8) {
+        h ^= mixRound(0, read64(data));
+        h = rotateLeft(h, 27) * prime1 + prime4;
+        data += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        h ^= quint64(read32(data)) * prime1;
+        h = rotateLeft(h, 23) * prime2 + prime3;
+        data += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        h ^= quint64(uchar(*data)) * prime5;
+        h = rotateLeft(h, 11) * prime1;
+        data++;
+        remaining--;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+quint64 Checksum::hash(const char *data, qint64 length, quint64 seed)
+{
+    Checksum checksum(seed);
+    checksum.addData(data, length);
+    return checksum.result();
+}
@@ -0,0 +1,37 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QtGlobal>
+
+// Streaming XXH64 checksum, used to verify the contents of payload entries
+class Checksum
+{
+public:
+    explicit Checksum(quint64 seed = 0);
+
+    void reset();
+    void addData(const char *data, qint64 length);
+    quint64 result() const;
+
+    static quint64 hash(const char *data, qint64 length, quint64 seed = 0);
+
+private:
+    quint64 seed;
+    quint64 accumulators[4];
+    quint64 totalLength = 0;
+    char stripe[32]; // pending bytes that do not fill a whole stripe yet
+    int stripeLength = 0;
+
+    void consumeStripes(const char *data, qint64 stripeCount);
+};
+
+#endif // CHECKSUM_H
@@ -0,0 +1,230 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "componentset.h"
+
+#include <QDir>
+
+namespace {
+const char *const stateNames[] = { "pending", "extracting", "finished", "skipped" };
+
+bool isInside(const QString &path, const QString &directoryPath)
+{
+    return path == directoryPath || (path.startsWith(directoryPath) && path.at(directoryPath.length()) == '/');
+}
+}
+
+bool ComponentSet::add(const Component &component, QString *errorString)
+{
+    QString path = QDir::cleanPath(QDir::fromNativeSeparators(component.path));
+    if (component.name.isEmpty()) {
+        *errorString = tr("Components must have a name");
+        return false;
+    } else if (indexOf(component.name) >= 0) {
+        *errorString = tr("The component already exists: %1").arg(component.name);
+        return false;
+    } else if (path.isEmpty() || path == "." || path.startsWith("../") || QDir::isAbsolutePath(path)) {
+        *errorString = tr("The path of a component must be relative to the data: %1").arg(component.path);
+        return false;
+    }
+    components.append(component);
+    components.last().path = path;
+    // Progress is read by other threads during the extraction, so its vectors are only sized here, while the installer is idle
+    sizes.append(QAtomicInteger<qint64>(0));
+    processedSizes.append(QAtomicInteger<qint64>(0));
+    states.append(QAtomicInt(Pending));
+    return true;
+}
+
+bool ComponentSet::setSelected(const QString &name, bool selected, QString *errorString)
+{
+    int component = indexOf(name);
+    if (component < 0) {
+        *errorString = tr("Unknown component: %1").arg(name);
+        return false;
+    } else if (!selected && !components.at(component).optional) {
+        *errorString = tr("The component is not optional: %1").arg(name);
+        return false;
+    }
+    components[component].selected = selected;
+    return true;
+}
+
+bool ComponentSet::isEmpty() const
+{
+    return components.isEmpty();
+}
+
+int ComponentSet::count() const
+{
+    return components.size();
+}
+
+const ComponentSet::Component &ComponentSet::at(int component) const
+{
+    return components.at(component);
+}
+
+bool ComponentSet::schedule(QString *errorString)
+{
+    // Dependencies of installed components are installed too, even if they were deselected
+    QVector<QVector<int>> dependencies(components.size());
+    installed.fill(false, components.size());
+    resolvedDependents.fill(QVector<int>(), components.size());
+    QVector<int> pending;
+    for (int component = 0; component < components.size(); component++) {
+        for (auto name : components.at(component).dependencies) {
+            int dependency = indexOf(name);
+            if (dependency < 0) {
+                *errorString = tr("The component %1 depends on an unknown component: %2").arg(components.at(component).name, name);
+                return false;
+            }
+            if (!dependencies.at(component).contains(dependency)) {
+                dependencies[component].append(dependency);
+            }
+        }
+        if (components.at(component).selected) {
+            installed[component] = true;
+            pending.append(component);
+        }
+    }
+    while (!pending.isEmpty()) {
+        for (int dependency : dependencies.at(pending.takeLast())) {
+            if (!installed.at(dependency)) {
+                installed[dependency] = true;
+                pending.append(dependency);
+            }
+        }
+    }
+
+    // Components are taken in the order they can be installed, those left over depend on each other
+    dependencyCounts.fill(0, components.size());
+    QVector<int> ready;
+    for (int component = 0; component < components.size(); component++) {
+        if (!installed.at(component)) {
+            continue;
+        }
+        dependencyCounts[component] = dependencies.at(component).size();
+        for (int dependency : dependencies.at(component)) {
+            resolvedDependents[dependency].append(component);
+        }
+        if (dependencies.at(component).isEmpty()) {
+            ready.append(component);
+        }
+    }
+    QVector<int> unfinishedDependencies = dependencyCounts;
+    int ordered = 0;
+    while (!ready.isEmpty()) {
+        ordered++;
+        for (int dependent : resolvedDependents.at(ready.takeLast())) {
+            if (--unfinishedDependencies[dependent] == 0) {
+                ready.append(dependent);
+            }
+        }
+    }
+    if (ordered != installed.count(true)) {
+        *errorString = tr("The dependencies of the components are circular");
+        return false;
+    }
+
+    for (int component = 0; component < components.size(); component++) {
+        sizes[component].storeRelease(0);
+        processedSizes[component].storeRelease(0);
+        states[component].storeRelease(installed.at(component) ? Pending : Skipped);
+    }
+    return true;
+}
+
+int ComponentSet::dependencyCount(int component) const
+{
+    return dependencyCounts.at(component);
+}
+
+const QVector<int> &ComponentSet::dependents(int component) const
+{
+    return resolvedDependents.at(component);
+}
+
+bool ComponentSet::isInstalled(int component) const
+{
+    return component < 0 || installed.value(component, true);
+}
+
+int ComponentSet::componentOf(const QString &relativePath) const
+{
+    // Components may be nested, the deepest one owns the path
+    int owner = -1;
+    for (int component = 0; component < components.size(); component++) {
+        const QString &path = components.at(component).path;
+        if (isInside(relativePath, path) && (owner < 0 || path.length() > components.at(owner).path.length())) {
+            owner = component;
+        }
+    }
+    return owner;
+}
+
+bool ComponentSet::isSkipped(const QString &relativeDirectoryPath) const
+{
+    if (isInstalled(componentOf(relativeDirectoryPath))) {
+        return false;
+    }
+    for (int component = 0; component < components.size(); component++) {
+        if (isInstalled(component) && isInside(components.at(component).path, relativeDirectoryPath)) {
+            return false; // an installed component nested in a skipped one
+        }
+    }
+    return true;
+}
+
+void ComponentSet::setSize(int component, qint64 size)
+{
+    sizes[component].storeRelease(size);
+}
+
+qint64 ComponentSet::size(int component) const
+{
+    return component < sizes.size() ? sizes.at(component).loadAcquire() : 0;
+}
+
+void ComponentSet::addProcessedSize(int component, qint64 size)
+{
+    if (component >= 0 && component < processedSizes.size()) {
+        processedSizes[component].fetchAndAddRelaxed(size);
+    }
+}
+
+qint64 ComponentSet::processedSize(int component) const
+{
+    return component < processedSizes.size() ? processedSizes.at(component).loadAcquire() : 0;
+}
+
+void ComponentSet::setState(int component, State state)
+{
+    states[component].storeRelease(state);
+}
+
+ComponentSet::State ComponentSet::state(int component) const
+{
+    return component < states.size() ? State(states.at(component).loadAcquire()) : Pending;
+}
+
+QString ComponentSet::stateName(State state)
+{
+    return stateNames[state];
+}
+
+int ComponentSet::indexOf(const QString &name) const
+{
+    for (int component = 0; component < components.size(); component++) {
+        if (components.at(component).name == name) {
+            return component;
+        }
+    }
+    return -1;
+}
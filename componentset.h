@@ -0,0 +1,73 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef COMPONENTSET_H
+#define COMPONENTSET_H
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVector>
+
+// Named parts of an installation. A component owns a directory of the data (or the payload) and everything in it,
+// files out of every component belong to the base of the installation, which is always installed.
+// A component is installed once its own dependencies are. The base and the components without dependencies start
+// right away, and components that do not depend on each other are extracted together, by the same workers.
+// Components are defined while the installer is idle. Progress members are thread-safe, their values are reset by
+// schedule() but never reallocated once the components are defined.
+class ComponentSet
+{
+    Q_DECLARE_TR_FUNCTIONS(ComponentSet)
+
+public:
+    enum State { Pending, Extracting, Finished, Skipped };
+
+    struct Component {
+        QString name;
+        QString path; // relative to the data root, '/' separated
+        QStringList dependencies; // names of other components
+        bool optional = false; // only optional components can be deselected
+        bool selected = true;
+    };
+
+    bool add(const Component &component, QString *errorString);
+    bool setSelected(const QString &name, bool selected, QString *errorString);
+    bool isEmpty() const;
+    int count() const;
+    const Component &at(int component) const;
+
+    bool schedule(QString *errorString); // resolves what is installed and the dependencies between them, and resets the progress
+    int dependencyCount(int component) const; // of an installed component, without duplicates
+    const QVector<int> &dependents(int component) const; // installed components that depend on it
+    bool isInstalled(int component) const; // selected, or a dependency of an installed component
+    int componentOf(const QString &relativePath) const; // -1 for the base
+    bool isSkipped(const QString &relativeDirectoryPath) const; // nothing in the directory is installed
+
+    void setSize(int component, qint64 size); // thread-safe
+    qint64 size(int component) const; // thread-safe
+    void addProcessedSize(int component, qint64 size); // thread-safe
+    qint64 processedSize(int component) const; // thread-safe
+    void setState(int component, State state); // thread-safe
+    State state(int component) const; // thread-safe
+
+    static QString stateName(State state);
+
+private:
+    QVector<Component> components;
+    QVector<bool> installed;
+    QVector<int> dependencyCounts;
+    QVector<QVector<int>> resolvedDependents;
+    QVector<QAtomicInteger<qint64>> sizes;
+    QVector<QAtomicInteger<qint64>> processedSizes;
+    QVector<QAtomicInt> states;
+
+    int indexOf(const QString &name) const;
+};
+
+#endif // COMPONENTSET_H
@@ -0,0 +1,277 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "delta.h"
+
+#include <QMultiHash>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+namespace {
+const int copyHeaderSize = 13;
+const int insertHeaderSize = 5;
+const qint64 maxInstructionLength = 1024 * 1024 * 1024; // 1 GiB, longer copies and inserts are split
+const qint64 copyPieceSize = 4 * 1024 * 1024; // 4 MiB, copies are written in pieces so progress keeps moving and cancellation is seen
+const int maxBlockCandidates = 16; // blocks with the same weak checksum compared before giving up
+
+// Weak checksum of a block, which can be rolled one byte at a time (see rsync)
+struct RollingChecksum {
+    quint32 a = 0;
+    quint32 b = 0;
+
+    void reset(const char *data, qint64 blockSize)
+    {
+        a = 0;
+        b = 0;
+        for (qint64 i = 0; i < blockSize; i++) {
+            a += uchar(data[i]);
+            b += quint32(blockSize - i) * uchar(data[i]);
+        }
+    }
+
+    void roll(uchar out, uchar in, qint64 blockSize)
+    {
+        a = a - out + in;
+        b = b - quint32(blockSize) * out + a;
+    }
+
+    quint32 value() const
+    {
+        return (a & 0xffff) | (b << 16);
+    }
+};
+
+void appendCopy(QByteArray *delta, quint64 offset, quint32 length)
+{
+    char header[copyHeaderSize];
+    header[0] = char(Delta::Copy);
+    qToLittleEndian<quint64>(offset, header + 1);
+    qToLittleEndian<quint32>(length, header + 9);
+    delta->append(header, copyHeaderSize);
+}
+
+void appendInsert(QByteArray *delta, const char *data, quint32 length)
+{
+    char header[insertHeaderSize];
+    header[0] = char(Delta::Insert);
+    qToLittleEndian<quint32>(length, header + 1);
+    delta->append(header, insertHeaderSize);
+    delta->append(data, int(length));
+}
+}
+
+//! Delta
+
+bool Delta::create(const char *base, qint64 baseSize, const char *target, qint64 targetSize, qint64 maxDeltaSize, QByteArray *delta, qint64 blockSize)
+{
+    delta->clear();
+    maxDeltaSize = qMin(maxDeltaSize, maxSize); // larger files are only patched if their delta is small enough
+
+    QMultiHash<quint32, qint64> blockOffsets;
+    blockOffsets.reserve(int(qMin<qint64>(baseSize / blockSize, std::numeric_limits<int>::max())));
+    RollingChecksum checksum;
+    for (qint64 offset = 0; offset + blockSize <= baseSize; offset += blockSize) {
+        checksum.reset(base + offset, blockSize);
+        blockOffsets.insert(checksum.value(), offset);
+    }
+
+    qint64 copyOffset = 0;
+    qint64 copyLength = 0;
+    qint64 literalStart = 0;
+    auto flushCopy = [&]() {
+        while (copyLength > 0) {
+            qint64 length = qMin(copyLength, maxInstructionLength);
+            appendCopy(delta, quint64(copyOffset), quint32(length));
+            copyOffset += length;
+            copyLength -= length;
+        }
+    };
+    auto flushLiteral = [&](qint64 end) {
+        while (literalStart < end) {
+            qint64 length = qMin(end - literalStart, maxInstructionLength);
+            appendInsert(delta, target + literalStart, quint32(length));
+            literalStart += length;
+        }
+    };
+
+    qint64 position = 0;
+    bool checksumIsValid = false;
+    while (position + blockSize <= targetSize) {
+        if (delta->size() + (position - literalStart) > maxDeltaSize) {
+            return false;
+        }
+        if (!checksumIsValid) {
+            checksum.reset(target + position, blockSize);
+            checksumIsValid = true;
+        }
+
+        qint64 match = -1;
+        int candidates = 0;
+        quint32 weakChecksum = checksum.value();
+        for (auto it = blockOffsets.constFind(weakChecksum); it != blockOffsets.constEnd() && it.key() == weakChecksum && candidates < maxBlockCandidates; ++it, ++candidates) {
+            if (memcmp(base + it.value(), target + position, size_t(blockSize)) == 0) {
+                match = it.value();
+                break;
+            }
+        }
+
+        if (match >= 0) {
+            if (literalStart < position) {
+                flushCopy();
+                flushLiteral(position);
+            }
+            if (copyLength > 0 && copyOffset + copyLength == match) {
+                copyLength += blockSize; // contiguous blocks become a single copy
+            } else {
+                flushCopy();
+                copyOffset = match;
+                copyLength = blockSize;
+            }
+            position += blockSize;
+            literalStart = position;
+            checksumIsValid = false;
+        } else {
+            if (position + blockSize < targetSize) {
+                checksum.roll(uchar(target[position]), uchar(target[position + blockSize]), blockSize);
+            }
+            position++;
+        }
+    }
+    if (delta->size() + (targetSize - literalStart) > maxDeltaSize) {
+        return false;
+    }
+    flushCopy();
+    flushLiteral(targetSize);
+    return delta->size() <= maxDeltaSize;
+}
+
+//! DeltaPatcher
+
+DeltaPatcher::DeltaPatcher(QFile &base, const Writer &write) : base(base), write(write)
+{
+    if (base.size() > 0) {
+        mappedBase = base.map(0, base.size());
+    }
+}
+
+DeltaPatcher::~DeltaPatcher()
+{
+    if (mappedBase) {
+        base.unmap(const_cast<uchar *>(mappedBase));
+    }
+}
+
+bool DeltaPatcher::addData(const char *data, qint64 size)
+{
+    while (size > 0) {
+        if (pendingInsertSize > 0) {
+            qint64 length = qMin<qint64>(size, pendingInsertSize);
+            if (!emitData(data, length)) {
+                return false;
+            }
+            data += length;
+            size -= length;
+            pendingInsertSize -= quint32(length);
+            continue;
+        }
+
+        // Instruction headers may be split between two chunks of the payload
+        int headerSize;
+        quint8 opcode = quint8(instruction.isEmpty() ? data[0] : instruction.at(0));
+        if (opcode == Delta::Copy) {
+            headerSize = copyHeaderSize;
+        } else if (opcode == Delta::Insert) {
+            headerSize = insertHeaderSize;
+        } else {
+            return fail(tr("Invalid delta instruction %1").arg(opcode));
+        }
+        qint64 length = qMin<qint64>(size, headerSize - instruction.size());
+        instruction.append(data, int(length));
+        data += length;
+        size -= length;
+        if (instruction.size() < headerSize) {
+            continue;
+        }
+
+        if (opcode == Delta::Copy) {
+            if (!copy(qFromLittleEndian<quint64>(instruction.constData() + 1), qFromLittleEndian<quint32>(instruction.constData() + 9))) {
+                return false;
+            }
+        } else {
+            pendingInsertSize = qFromLittleEndian<quint32>(instruction.constData() + 1);
+        }
+        instruction.clear();
+    }
+    return true;
+}
+
+bool DeltaPatcher::finish()
+{
+    if (!instruction.isEmpty() || pendingInsertSize > 0) {
+        return fail(tr("Truncated delta"));
+    }
+    return true;
+}
+
+qint64 DeltaPatcher::writtenSize() const
+{
+    return totalWrittenSize;
+}
+
+QString DeltaPatcher::errorString() const
+{
+    return lastError;
+}
+
+bool DeltaPatcher::copy(quint64 offset, quint32 length)
+{
+    if (offset > quint64(base.size()) || length > quint64(base.size()) - offset) {
+        return fail(tr("Invalid delta, the previous version of the file is too small"));
+    }
+    if (!mappedBase && !base.seek(qint64(offset))) {
+        return fail(base.errorString());
+    }
+
+    qint64 remainingLength = length;
+    while (remainingLength > 0) {
+        qint64 pieceSize = qMin(remainingLength, copyPieceSize);
+        if (mappedBase) {
+            if (!emitData(reinterpret_cast<const char *>(mappedBase) + offset, pieceSize)) {
+                return false;
+            }
+        } else {
+            QByteArray piece = base.read(pieceSize);
+            if (piece.size() != pieceSize) {
+                return fail(base.errorString());
+            }
+            if (!emitData(piece.constData(), pieceSize)) {
+                return false;
+            }
+        }
+        offset += quint64(pieceSize);
+        remainingLength -= pieceSize;
+    }
+    return true;
+}
+
+bool DeltaPatcher::emitData(const char *data, qint64 size)
+{
+    if (!write(data, size)) {
+        return fail(tr("Failure to write block"));
+    }
+    totalWrittenSize += size;
+    return true;
+}
+
+bool DeltaPatcher::fail(const QString &error)
+{
+    lastError = error;
+    return false;
+}
@@ -0,0 +1,67 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <functional>
+
+// Binary delta between two versions of a file, stored in the delta entries of a payload. It is a sequence of
+// instructions that rebuild the new version from the old one (little-endian):
+//
+//   copy   | opcode 1, offset in the old version (quint64), length (quint32)
+//   insert | opcode 2, length (quint32), data
+//
+// Deltas are created by matching blocks of the old version with a rolling checksum, like rsync does.
+namespace Delta {
+enum Opcode : quint8 { Copy = 1, Insert = 2 };
+
+const qint64 defaultBlockSize = 16 * 1024; // 16 KiB
+const qint64 maxSize = 1024 * 1024 * 1024; // 1 GiB, deltas are built in memory, in a QByteArray
+
+// Returns false if the delta would be bigger than maxDeltaSize, or than maxSize
+bool create(const char *base, qint64 baseSize, const char *target, qint64 targetSize, qint64 maxDeltaSize, QByteArray *delta,
+            qint64 blockSize = defaultBlockSize);
+}
+
+// Applies a delta as it is read, writing the new version of the file through a callback. Copies are written in pieces
+// of at most 4 MiB, and inserts as they are received, so the callback may also stop patching (e.g. when canceled)
+class DeltaPatcher
+{
+    Q_DECLARE_TR_FUNCTIONS(DeltaPatcher)
+
+public:
+    typedef std::function<bool (const char *data, qint64 size)> Writer;
+
+    DeltaPatcher(QFile &base, const Writer &write);
+    ~DeltaPatcher();
+
+    bool addData(const char *data, qint64 size);
+    bool finish(); // fails if the delta ends in the middle of an instruction
+    qint64 writtenSize() const;
+    QString errorString() const;
+
+private:
+    QFile &base;
+    Writer write;
+    const uchar *mappedBase = nullptr;
+    QByteArray instruction; // pending bytes of an incomplete instruction header
+    quint32 pendingInsertSize = 0; // data of the current insert instruction not received yet
+    qint64 totalWrittenSize = 0;
+    QString lastError;
+
+    bool copy(quint64 offset, quint32 length);
+    bool emitData(const char *data, qint64 size);
+    bool fail(const QString &error);
+};
+
+#endif // DELTA_H
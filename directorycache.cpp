@@ -0,0 +1,71 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "directorycache.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+void DirectoryCache::reset(const QString &path, bool existing)
+{
+    QMutexLocker locker(&mutex);
+    rootPath = QDir::cleanPath(path);
+    existingTree = existing;
+    directories.clear();
+    createdDirectories.clear();
+}
+
+bool DirectoryCache::makePath(const QString &path)
+{
+    return makeCleanPath(QDir::cleanPath(path));
+}
+
+bool DirectoryCache::wasCreated(const QString &path) const
+{
+    QMutexLocker locker(&mutex);
+    return createdDirectories.contains(QDir::cleanPath(path));
+}
+
+bool DirectoryCache::makeCleanPath(const QString &path)
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (directories.contains(path)) {
+            return true;
+        }
+    }
+
+    // The root and anything out of it is only created once, so QDir::mkpath() is fine there.
+    // Directories below are created after their parent, which is then known to exist.
+    // Other threads may be creating the same directory, so a failed mkdir() is fine if the directory is there
+    QDir d;
+    bool created;
+    bool madeHere = false; // by this call, not by another thread nor before
+    int separator = path.lastIndexOf('/');
+    bool belowRoot = path.length() > rootPath.length() && path.startsWith(rootPath) && (rootPath.endsWith('/') || path.at(rootPath.length()) == '/');
+    if (!belowRoot || separator <= 0) {
+        created = d.exists(path) || d.mkpath(path);
+    } else if (!makeCleanPath(path.left(separator))) {
+        created = false;
+    } else if (existingTree && QFileInfo(path).isDir()) {
+        created = true;
+    } else {
+        madeHere = d.mkdir(path);
+        created = madeHere || QFileInfo(path).isDir();
+    }
+
+    if (created) {
+        QMutexLocker locker(&mutex);
+        directories.insert(path);
+        if (madeHere) {
+            createdDirectories.insert(path);
+        }
+    }
+    return created;
+}
@@ -0,0 +1,39 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef DIRECTORYCACHE_H
+#define DIRECTORYCACHE_H
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Creates the directories of an installation, remembering the ones that exist already.
+// QDir::mkpath() checks every parent of the path on every call, while here a directory costs a single mkdir()
+// the first time and nothing afterwards, no matter how many files it holds or how deep it is. Thread-safe.
+class DirectoryCache
+{
+public:
+    // Forgets every directory. Directories under rootPath are expected to be new, unless existingTree is true (e.g. updates)
+    void reset(const QString &rootPath, bool existingTree = false);
+
+    bool makePath(const QString &path); // creates the directory and its missing parents, like QDir::mkpath()
+    bool wasCreated(const QString &path) const; // whether makePath() created the directory below the root, not found it
+
+private:
+    QString rootPath;
+    bool existingTree = false;
+    mutable QMutex mutex; // guards directories and createdDirectories
+    QSet<QString> directories;
+    QSet<QString> createdDirectories;
+
+    bool makeCleanPath(const QString &path);
+};
+
+#endif // DIRECTORYCACHE_H
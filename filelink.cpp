@@ -0,0 +1,74 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "filelink.h"
+
+#include <QFile>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#ifdef Q_OS_MACOS
+#include <sys/clonefile.h>
+#endif
+
+bool FileLink::hardLink(const QString &filePath, const QString &linkPath)
+{
+#ifdef Q_OS_WIN
+    return CreateHardLinkW(reinterpret_cast<const wchar_t *>(linkPath.utf16()), reinterpret_cast<const wchar_t *>(filePath.utf16()), nullptr);
+#else
+    return link(QFile::encodeName(filePath).constData(), QFile::encodeName(linkPath).constData()) == 0;
+#endif
+}
+
+bool FileLink::clone(const QString &sourceFilePath, const QString &destinationFilePath)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    int source = open(QFile::encodeName(sourceFilePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        return false;
+    }
+    QByteArray destinationPath = QFile::encodeName(destinationFilePath);
+    int destination = open(destinationPath.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (destination < 0) {
+        close(source);
+        return false;
+    }
+    bool cloned = ioctl(destination, FICLONE, source) == 0;
+    close(destination);
+    close(source);
+    if (!cloned) {
+        unlink(destinationPath.constData()); // created by this function, an empty file
+    }
+    return cloned;
+#elif defined(Q_OS_MACOS)
+    return clonefile(QFile::encodeName(sourceFilePath).constData(), QFile::encodeName(destinationFilePath).constData(), CLONE_NOFOLLOW) == 0;
+#else
+    Q_UNUSED(sourceFilePath)
+    Q_UNUSED(destinationFilePath)
+    return false;
+#endif
+}
+
+bool FileLink::replace(const QString &filePath, const QString &targetPath)
+{
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(filePath.utf16()), reinterpret_cast<const wchar_t *>(targetPath.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return rename(QFile::encodeName(filePath).constData(), QFile::encodeName(targetPath).constData()) == 0;
+#endif
+}
@@ -0,0 +1,29 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef FILELINK_H
+#define FILELINK_H
+
+#include <QString>
+
+// Makes a file available at a second path without writing its contents again. hardLink() and clone() fail if the destination
+// exists, or if the file system (or the system) does not support them, so callers can fall back to copying the file.
+class FileLink
+{
+public:
+    // Hard link: both paths are the same file, so they share their contents, permissions and future changes
+    static bool hardLink(const QString &filePath, const QString &linkPath);
+    // Reflink (copy-on-write clone): a new file that shares the blocks of the source until either is modified.
+    // Supported by Btrfs, XFS and others on Linux, and APFS on macOS
+    static bool clone(const QString &sourceFilePath, const QString &destinationFilePath);
+    // Renames a file over an existing one in a single step, so the target path always holds one of both files
+    static bool replace(const QString &filePath, const QString &targetPath);
+};
+
+#endif // FILELINK_H
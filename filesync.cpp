@@ -0,0 +1,114 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "filesync.h"
+
+#include <QFileInfo>
+#include <cerrno>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+bool syncDescriptor(int fd)
+{
+#ifdef Q_OS_WIN
+    return _commit(fd) == 0;
+#else
+    int result;
+    do {
+        result = fsync(fd);
+    } while (result != 0 && errno == EINTR);
+    return result == 0;
+#endif
+}
+}
+
+//! FileSync
+
+bool FileSync::syncFile(QFile &file)
+{
+    return file.flush() && file.handle() >= 0 && syncDescriptor(file.handle());
+}
+
+bool FileSync::syncPath(const QString &path)
+{
+#ifdef Q_OS_WIN
+    // Directories cannot be synced, their entries are written with the files
+    if (QFileInfo(path).isDir()) {
+        return true;
+    }
+    QFile file(path);
+    return file.open(QIODevice::ReadWrite) && syncFile(file); // flushing needs write access
+#else
+    int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = syncDescriptor(fd);
+    close(fd);
+    return synced;
+#endif
+}
+
+bool FileSync::syncFileSystem(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = syncfs(fd) == 0;
+    close(fd);
+    return synced;
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
+void FileSync::preallocate(QFile &file, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    // The size is kept, so a failed extraction never leaves a file that looks complete
+    if (size >= largeFileSize && file.handle() >= 0) {
+        fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, off_t(size));
+    }
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(size)
+#endif
+}
+
+void FileSync::adviseSequentialRead(QFile &file, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    if (size >= largeFileSize && file.handle() >= 0) {
+        posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(size)
+#endif
+}
+
+void FileSync::startWriteBack(QFile &file, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    if (size >= largeFileSize && file.handle() >= 0) {
+        sync_file_range(file.handle(), 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(size)
+#endif
+}
@@ -0,0 +1,32 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef FILESYNC_H
+#define FILESYNC_H
+
+#include <QFile>
+#include <QString>
+
+// Controls when written data reaches the disk. Syncs fail if the data could not be written, while hints
+// (preallocation, read-ahead and write-back) are best effort and do nothing where the system has no equivalent.
+class FileSync
+{
+public:
+    static const qint64 largeFileSize = 1024 * 1024; // 1 MiB, smaller files gain nothing from hints
+
+    static bool syncFile(QFile &file); // data and metadata of an open file
+    static bool syncPath(const QString &path); // file or directory that is not open, directories are skipped on Windows
+    static bool syncFileSystem(const QString &path); // every file of the file system holding path, false if not supported (Linux only)
+
+    static void preallocate(QFile &file, qint64 size); // reserves the blocks of a large file, so it is written in few extents
+    static void adviseSequentialRead(QFile &file, qint64 size);
+    static void startWriteBack(QFile &file, qint64 size); // starts writing a large file to the disk, without waiting for it
+};
+
+#endif // FILESYNC_H
@@ -9,6 +9,80 @@
 
 #include "installer.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define SIF_HAS_COPY_FILE_RANGE
+#endif
+#endif
+
+namespace {
+const qint64 minimumProgressSampleInterval = 100; // ms
+const double throughputTimeConstant = 2000; // ms
+const unsigned long discoveryPollInterval = 100; // ms
+const qint64 minCopyBufferSize = 4 * 1024; // 4 KiB
+const qint64 maxCopyBufferSize = 4 * 1024 * 1024; // 4 MiB
+const qint64 minPayloadBufferSize = 1024 * 1024; // 1 MiB
+const qint64 minMemoryLimit = 1024 * 1024; // 1 MiB
+const qint64 verificationBufferSize = 1024 * 1024; // 1 MiB
+const char installedFilesListName[] = ".sif-files"; // relative paths of the installed files, used by updates
+const unsigned ioUringQueueDepth = 64;
+#ifdef Q_OS_LINUX
+const qint64 kernelCopyChunkSize = 8 * 1024 * 1024; // 8 MiB, bounds the time to stop when canceled
+#ifdef SIF_HAS_COPY_FILE_RANGE
+const bool hasCopyFileRange = true;
+#else
+const bool hasCopyFileRange = false;
+#endif
+#endif
+
+bool hashFile(const QString &path, QByteArray *buffer, CancellationToken &cancellation, quint64 *checksum)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    Checksum hash;
+    buffer->resize(buffer->capacity());
+    qint64 readSize;
+    while ((readSize = file.read(buffer->data(), buffer->size())) > 0) {
+        if (!cancellation.checkpoint()) {
+            return false;
+        }
+        hash.addData(buffer->constData(), readSize);
+    }
+    *checksum = hash.result();
+    return readSize == 0;
+}
+
+quint32 posixMode(QFile::Permissions permissions)
+{
+    quint32 mode = 0;
+    mode |= permissions.testFlag(QFile::ReadOwner) ? 0400 : 0;
+    mode |= permissions.testFlag(QFile::WriteOwner) ? 0200 : 0;
+    mode |= permissions.testFlag(QFile::ExeOwner) ? 0100 : 0;
+    mode |= permissions.testFlag(QFile::ReadGroup) ? 0040 : 0;
+    mode |= permissions.testFlag(QFile::WriteGroup) ? 0020 : 0;
+    mode |= permissions.testFlag(QFile::ExeGroup) ? 0010 : 0;
+    mode |= permissions.testFlag(QFile::ReadOther) ? 0004 : 0;
+    mode |= permissions.testFlag(QFile::WriteOther) ? 0002 : 0;
+    mode |= permissions.testFlag(QFile::ExeOther) ? 0001 : 0;
+    return mode;
+}
+
+IoUring *threadIoUring() // every extraction thread has its own ring, created on first use
+{
+    thread_local IoUring ring(ioUringQueueDepth);
+    return ring.isValid() ? &ring : nullptr;
+}
+}
+
 Installer::Installer(QObject *parent) : QObject(parent)
 {
     qRegisterMetaType<Installer::InstallerStatus>("InstallerStatus");
@@ -18,10 +92,14 @@ Installer::Installer(QObject *parent) : QObject(parent)
     QString currentOSName = currentOS == QOperatingSystemVersion::Windows ? "windows" :
                             currentOS == QOperatingSystemVersion::MacOS ? "macos" : "unix";
     dataPath = QString(":/") + currentOSName + "/data";
+    payloadPath = QString(":/") + currentOSName + "/data.sif";
     desktopEntriesPath = QString(":/") + currentOSName + "/desktop_entries";
 
+    extractionPool.setMaxThreadCount(qMax(1, maxConcurrentExtractions - 1));
+
     setupInitialInstallationPath();
     setupExtractingProcess();
+    setupProgressReporting();
 }
 
 void Installer::setupInitialInstallationPath()
@@ -60,7 +138,8 @@ void Installer::validateInstallationPath()
     } else if (!installationPathInfo.isAbsolute()) {
         setInstallationPathIsValid(false);
         setInstallationPathError(PathIsNotAbsolute);
-    } else if (QDir(installationPath).entryList(QDir::AllEntries | QDir::NoDotAndDotDot).count() > 0) { // We currently do not allow updates
+    } else if (!updateMode && QDir(installationPath).entryList(QDir::AllEntries | QDir::NoDotAndDotDot).count() > 0
+               && !(resumable && !transactional && QFile::exists(Checkpoint::checkpointPath(installationPath)))) { // Only updates and interrupted resumable installations are allowed on existing installations
         setInstallationPathIsValid(false);
         setInstallationPathError(PathIsNotEmpty);
     } else {
@@ -74,45 +153,120 @@ void Installer::validateInstallationPath()
 
 void Installer::setupExtractingProcess()
 {
-    connect(&watcherSeeking, &QFutureWatcher<QPair<QFileInfoList, qint64>>::finished, [&]() {
-        if (extractionCanceled) {
-            setInstallerStatus(InstallerStatus::ExtractionCanceled);
-            emit reversionFinished();
-        } else {
-            QPair<QFileInfoList, qint64> seekingResult = watcherSeeking.result();
-            filesToExtract = seekingResult.first;
-            setTotalSize(seekingResult.second);
-            setInstallerStatus(ExtractingPackages);
-            emit extractionStarted();
-            QFuture<void> futureExtracting = QtConcurrent::run([&]() {
-                if (!extractFiles()) {
-                    setInstallerStatus(InstallerStatus::ErrorOccurred);
-                }
-            });
-            watcherExtracting.setFuture(futureExtracting);
+    // Extractions end on the thread that ran them, the totals are published on the thread of the installer.
+    // Connected first, so they are up to date for every other handler
+    connect(this, &Installer::installerStatusChanged, this, [this](InstallerStatus status) {
+        if (status == ExtractionFinished || status == ExtractionCanceled || status == ErrorOccurred || status == ExtractionSuspended) {
+            publishDiscoveredTotals();
         }
     });
+}
 
-    connect(&watcherExtracting, &QFutureWatcher<void>::finished, [&]() {
-        if (extractionCanceled) {
-            setInstallerStatus(ExtractionCanceled);
-            emit reversionFinished();
-        } else if (installerStatus != InstallerStatus::ErrorOccurred) {
-            setInstallerStatus(ExtractionFinished);
-            emit extractionFinished();
+void Installer::setupProgressReporting()
+{
+    connect(&progressTimer, &QTimer::timeout, this, &Installer::requestProgress);
+
+    // Queued when the status changes on a worker thread, so the timer is always handled from the thread of the installer
+    connect(this, &Installer::installerStatusChanged, this, [this](InstallerStatus status) {
+        // Every phase measures its own throughput
+        progressClock.start();
+        lastProgressSampleTime = 0;
+        lastProgressSampleSize = 0;
+        throughput = 0;
+        remainingTime = -1;
+
+        bool inProgress = status == FetchingFiles || status == ExtractingPackages || status == RevertingInstallation;
+        if (progressInterval > 0) {
+            if (inProgress) {
+                progressTimer.start(progressInterval);
+            } else {
+                progressTimer.stop();
+            }
+            requestProgress(); // the first and the last report of every phase
         }
     });
 }
 
 void Installer::requestProgress()
 {
-    double progress = double(extractedSize)/totalSize;
+    publishDiscoveredTotals();
+    updateThroughput();
+    double progress = getProgress();
     emit progressReported(progress);
+    emit progressChanged();
+}
+
+void Installer::publishDiscoveredTotals()
+{
+    // Sizes are tallied by the workers while files are being extracted, but the properties only change on the thread of the installer
+    setTotalSize(discoveredSize.loadAcquire());
+    setTotalFileCount(discoveredFileCount.loadAcquire());
+}
+
+void Installer::updateThroughput()
+{
+    if (!progressClock.isValid()) {
+        return;
+    }
+    qint64 now = progressClock.elapsed();
+    qint64 interval = now - lastProgressSampleTime;
+    if (interval < minimumProgressSampleInterval) {
+        return; // too close to the last sample to measure anything
+    }
+
+    qint64 processedSize = installerStatus == RevertingInstallation ? sizeToRevert - extractedSize.loadAcquire() : extractedSize.loadAcquire();
+    qint64 pendingSize = (installerStatus == RevertingInstallation ? sizeToRevert : totalSize) - processedSize;
+    double currentThroughput = double(processedSize - lastProgressSampleSize) * 1000 / interval;
+
+    // Exponential moving average: recent samples weigh more, but a single slow file does not ruin the estimation
+    double weight = lastProgressSampleTime == 0 ? 1.0 : 1.0 - qExp(-double(interval) / throughputTimeConstant);
+    throughput += weight * (currentThroughput - throughput);
+    remainingTime = throughput > 0 && installerStatus != FetchingFiles ? qint64(qMax<qint64>(0, pendingSize) * 1000 / throughput) : -1;
+
+    lastProgressSampleTime = now;
+    lastProgressSampleSize = processedSize;
 }
 
 void Installer::cancel()
 {
-    extractionCanceled = true;
+    bool wasPaused = cancellation.isPaused();
+    cancellation.cancel();
+    discoveryCondition.wakeAll(); // extraction workers waiting for files to be found
+    if (wasPaused) {
+        emit pausedChanged(false);
+    }
+}
+
+void Installer::pause()
+{
+    if (installerStatus != FetchingFiles && installerStatus != ExtractingPackages) {
+        qCritical("The installation can only be paused while files are being fetched or extracted");
+        return;
+    } else if (!cancellation.isPaused()) {
+        cancellation.pause();
+        emit pausedChanged(true);
+    }
+}
+
+void Installer::resume()
+{
+    if (cancellation.isPaused()) {
+        cancellation.resume();
+        emit pausedChanged(false);
+    }
+}
+
+void Installer::suspend()
+{
+    if (installerStatus != FetchingFiles && installerStatus != ExtractingPackages) {
+        qCritical("The installation can only be suspended while files are being fetched or extracted");
+        return;
+    } else if (!resumable || transactional) {
+        qCritical("Only resumable installations can be suspended, transactional ones start over");
+        return;
+    }
+    suspendRequested.storeRelease(1);
+    cancel();
 }
 
 bool Installer::addDesktopShortcut(const QString &linkName, const QString &executableEntryFilePath)
@@ -156,6 +310,7 @@ bool Installer::addDesktopShortcut(const QString &linkName, const QString &execu
         qCritical("Cannot create link \'%s\' pointing to \'%s\': %s", qPrintable(linkDesktop), qPrintable(newExecutableEntryFilePath), qPrintable(executableEntryFile.errorString()));
         return false;
     }
+    addIntegrationEntry(linkDesktop);
 
     return true;
 }
@@ -196,6 +351,7 @@ bool Installer::addWindowsStartMenuEntry(const QString &linkName, const QString
         qCritical("Cannot create link \'%s\' pointing to \'%s\': %s", qPrintable(linkFilePath), qPrintable(newFilePath), qPrintable(fileToLink.errorString()));
         return false;
     }
+    addIntegrationEntry(linkFilePath);
     return true;
 }
 
@@ -235,6 +391,7 @@ bool Installer::addDesktopEntry(const QString &name)
         qCritical("Cannot create file \'%s\': %s", qPrintable(desktopEntryFilePath), qPrintable(desktopEntrySourceFile.errorString()));
         return false;
     }
+    addIntegrationEntry(desktopEntryFilePath);
 
     return true;
 }
@@ -273,268 +430,2442 @@ void Installer::addWindowsControlPanelUninstallerEntry(const QString &applicatio
     sUnins.setValue("Publisher", QCoreApplication::organizationName());
     sUnins.setValue("UninstallString", QDir::toNativeSeparators(newUninstallerFilePath));
     sUnins.setValue("UrlInfoAbout", moreInfoUrl);
+
+    QMutexLocker locker(&integrationMutex);
+    controlPanelEntryAdded = true;
+}
+
+void Installer::addIntegrationEntry(const QString &filePath)
+{
+    QMutexLocker locker(&integrationMutex);
+    if (!integrationEntries.contains(filePath)) {
+        integrationEntries << filePath;
+    }
 }
 
 void Installer::extractAll()
 {
-    QFuture<QPair<QFileInfoList, qint64>> futureSeeking = QtConcurrent::run([=]() {
-        setInstallerStatus(FetchingFiles);
-        emit fetchingStarted();
-        return findFilesToExtract(dataPath);
-    });
-    watcherSeeking.setFuture(futureSeeking);
+    extractAllAsync();
 }
 
-QPair<QFileInfoList, qint64> Installer::findFilesToExtract(const QString &path)
+QFuture<bool> Installer::extractAllAsync()
 {
-    qint64 size = 0;
-    QFileInfoList files;
+    prepareExtraction();
+    return QtConcurrent::run([this]() {
+        return runExtraction();
+    });
+}
 
-    QStringList pendingDirectoriesPath;
-    pendingDirectoriesPath.append(path);
+bool Installer::extractAllAndWait()
+{
+    prepareExtraction();
+    return runExtraction();
+}
 
-    while (!pendingDirectoriesPath.empty()) {
-        QString pendingDirectoryPath = pendingDirectoriesPath.first();
-        QDir currentDirectory(pendingDirectoryPath);
+void Installer::prepareExtraction()
+{
+    cancellation.reset();
+    suspendRequested.storeRelease(0);
+    extractedSize.storeRelease(0);
+    extractedFileCount.storeRelease(0);
+    discoveredSize.storeRelease(0);
+    discoveredFileCount.storeRelease(0);
+    publishDiscoveredTotals();
+    bool staging = transactional && !updateMode; // updates are journaled in place
+    tracer.reset(tracingEnabled, traceSamplingInterval);
+    extractionRoot = (staging ? Journal::stagingPath(installationPath) : QDir::cleanPath(installationPath)) + '/';
+    bool resuming = resumable && !transactional && QFile::exists(Checkpoint::checkpointPath(installationPath));
+    directoryCache.reset(extractionRoot, updateMode || resuming);
+}
 
-        for (auto fileInfo : currentDirectory.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
-            if (extractionCanceled) {
-                return { QFileInfoList(), 0 };
-            } else if (fileInfo.isDir()) {
-                pendingDirectoriesPath.append(fileInfo.filePath());
-            } else {
-                size += fileInfo.size();
-                files.append(fileInfo);
-            }
-        }
-        pendingDirectoriesPath.removeFirst();
+bool Installer::runExtraction()
+{
+    bool extracted = extractInstallation();
+    payload.close();
+    // Interrupted resumable installations keep their checkpoint, finished and reverted ones removed it already
+    if (!checkpoint.close()) {
+        qWarning("Unable to save the installation checkpoint: %s", qPrintable(checkpoint.errorString()));
     }
-
-    // now add the size of additional files
-    for (auto pair : additionalFiles) {
-        size += QFileInfo(pair.first).size();
+    // A successful installation stays, even if it was canceled too late to be reverted
+    bool canceled = !extracted && cancellation.isCanceled();
+    if (canceled && suspendRequested.loadAcquire()) {
+        setInstallerStatus(ExtractionSuspended);
+        emit extractionSuspended();
+    } else if (canceled) {
+        setInstallerStatus(ExtractionCanceled);
+        emit reversionFinished();
+    } else if (!extracted) {
+        setInstallerStatus(InstallerStatus::ErrorOccurred);
+    } else {
+        setInstallerStatus(ExtractionFinished);
+        emit extractionFinished();
     }
-
-    return { files, size };
+    return extracted;
 }
 
-bool Installer::addFileToExtract(const QString &from, const QString &to)
+bool Installer::extractInstallation()
 {
-    if (installerStatus != Idle) {
-        qCritical("Files can only be added in IDLE installer status");
+    setInstallerStatus(FetchingFiles);
+    emit fetchingStarted();
+
+    // An interrupted transactional installation is rolled back (or finished) before anything else
+    // Updates have no staging directory, their files are journaled in place
+    bool journalReady = transactional ? journal.begin(installationPath, !updateMode) : journal.recover(installationPath);
+    if (!journalReady) {
+        emit extractionError(QFile::FatalError, journal.errorString());
         return false;
-    } else if (!QFile::exists(from)) {
-        qCritical("File \'%s\' doesn't exists", qPrintable(from));
+    }
+
+    // A resumable installation continues from its checkpoint, if it was interrupted. Transactional ones always start over
+    if (resumable && !transactional && !checkpoint.open(installationPath, checkpointSource())) {
+        emit extractionError(QFile::FatalError, checkpoint.errorString());
         return false;
     }
 
-    additionalFiles << QPair<QString, QString>(from, to);
-    return true;
-}
+    // Files of components that are not installed are left out of the manifest
+    QString componentsError;
+    if (!components.schedule(&componentsError)) {
+        emit extractionError(QFile::FatalError, componentsError);
+        return false;
+    }
+    entryComponents.clear();
+
+    // Additional files are the first entries of the manifest
+    manifest.clear();
+    for (int i = 0; i < additionalFiles.size(); i++) {
+        qint64 size = QFileInfo(additionalFiles.at(i).first).size();
+        manifest.addEntry(additionalFiles.at(i).second, size, QFile::Permissions(), Manifest::Additional, i);
+        discoveredSize.fetchAndAddRelaxed(size);
+        discoveredFileCount.fetchAndAddRelaxed(1);
+    }
 
-bool Installer::extractFiles()
-{
-    for (auto fileInfo : filesToExtract) {
-        QString originFilePath = fileInfo.filePath();
-        QString destinationFilePath = installationPath + (installationPath.endsWith('/') ? "" : "/") + QString(originFilePath).remove(dataPath + '/');
-        QDir d(destinationFilePath);
-        if (!d.exists()) {
-            if (!d.mkpath(QFileInfo(destinationFilePath).path())) {
-                emit extractionError(QFile::PermissionsError, tr("Access denied to create the path: %1").arg(QFileInfo(destinationFilePath).path()));
-                return false;
-            }
-        }
-        QPair<QFile::FileError, QString> singleExtractionResult = extractSingleFile(originFilePath, destinationFilePath);
-        if (extractionCanceled) {
-            revertInstallation();
-            return false;
-        } else if (singleExtractionResult.first != QFile::NoError) {
-            emit extractionError(singleExtractionResult.first, singleExtractionResult.second);
+    if (QFile::exists(payloadPath)) {
+        if (!readPayload()) {
             return false;
         }
-        extractedFiles.append(QFileInfo(destinationFilePath));
+    } else {
+        // Files are extracted as soon as they are found, so the extraction starts right away
+        findFilesToExtract();
     }
 
-    // extract additional files
-    for (auto pair : additionalFiles) {
-        QString origin = pair.first;
-        QString destination = pair.second;
-        QPair<QFile::FileError, QString> singleExtractionResult = extractSingleFile(origin, destination);
-        if (extractionCanceled) {
-            revertInstallation();
-            return false;
-        } else if (singleExtractionResult.first != QFile::NoError) {
-            emit extractionError(singleExtractionResult.first, singleExtractionResult.second);
-            return false;
-        }
-        extractedFiles.append(QFileInfo(destination));
+    setInstallerStatus(ExtractingPackages);
+    emit extractionStarted();
+    return extractFiles();
+}
+
+QString Installer::checkpointSource() const
+{
+    // A checkpoint is only resumed by an installation of the same files
+    if (QFile::exists(payloadPath)) {
+        return QString("payload %1 %2").arg(payloadPath).arg(QFileInfo(payloadPath).size());
     }
+    return QString("data %1").arg(dataPath);
+}
 
-    return true;
+void Installer::findFilesToExtract()
+{
+    QMutexLocker locker(&manifestMutex);
+    discoveredEntries.clear();
+    discoveryError = { QFile::NoError, QString() };
+    discoveryStopped.storeRelease(0);
+    pendingDirectoryCount = 1;
+    QtConcurrent::run(&discoveryPool, [this]() {
+        findFilesInDirectory(QString());
+    });
 }
 
-QPair<QFile::FileError, QString> Installer::extractSingleFile(const QString &origin, const QString &destination)
+void Installer::findFilesInDirectory(const QString &relativePath)
 {
-    QFile in(origin);
-    QFile out(destination);
+    QFileInfoList files;
+    QStringList subdirectoriesPath;
+    qint64 size = 0;
 
-    if (origin.isEmpty()) {
-        return { QFile::FatalError, tr("Empty or null source file name: %1").arg(origin) };
-    }
-    if (QFile::exists(destination)) {
-        return { QFile::CopyError, tr("Destination file exists: %1").arg(destination) };
+    Tracer::FileScope directoryScope(tracer, extractionRoot + relativePath); // directories are sampled like files
+    bool skipped = !relativePath.isEmpty() && !components.isEmpty() && components.isSkipped(relativePath);
+    if (!skipped && !discoveryStopped.loadAcquire() && cancellation.checkpoint()) {
+        QString directoryPath = relativePath.isEmpty() ? dataPath : dataPath + '/' + relativePath;
+        QString prefix = relativePath.isEmpty() ? QString() : relativePath + '/';
+        Tracer::Scope scanScope(tracer, Tracer::Scan, directoryPath);
+        for (auto fileInfo : QDir(directoryPath).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (fileInfo.isDir()) {
+                subdirectoriesPath.append(prefix + fileInfo.fileName());
+            } else {
+                size += fileInfo.size();
+                files.append(fileInfo);
+            }
+        }
     }
-    if (!in.open(QFile::ReadOnly)) {
-        return { in.error(), in.errorString() };
-    } else {
 
-        if (!out.open(QIODevice::ReadWrite)) {
-            in.close();
-            return { out.error(), out.errorString() };
-        } else {
-            char block[4096];
-            qint64 bytesCopied = 0;
-            while (!in.atEnd()) {
-                if (extractionCanceled) {
-                    out.remove();
-                    return { QFile::AbortError, tr("Operation canceled") };
-                }
-                qint64 inFlow = in.read(block, sizeof(block));
-                if (inFlow <= 0) {
-                    break;
-                }
-                bytesCopied += inFlow;
-                extractedSize += inFlow;
-
-                if (inFlow != out.write(block, inFlow)) {
-                    in.close();
-                    out.close();
-                    out.remove();
-                    return { QFile::WriteError, tr("Failure to write block") };
-                }
+    // The directory is created before any of its files can be taken by an extraction worker.
+    // A failed extraction leaves the rest of the tree alone
+    if (discoveryStopped.loadAcquire()) {
+        files.clear();
+        subdirectoriesPath.clear();
+        size = 0;
+    }
+    if (!files.isEmpty()) {
+        QString destinationDirectoryPath = extractionRoot + relativePath;
+        Tracer::Scope mkdirScope(tracer, Tracer::MakeDirectory, destinationDirectoryPath);
+        if (!directoryCache.makePath(destinationDirectoryPath)) {
+            QMutexLocker locker(&manifestMutex);
+            if (discoveryError.first == QFile::NoError) {
+                discoveryError = { QFile::PermissionsError, tr("Access denied to create the path: %1").arg(destinationDirectoryPath) };
             }
+            files.clear();
+            subdirectoriesPath.clear();
+            size = 0;
+        }
+    }
 
-            if (bytesCopied != in.size()) {
-                out.remove();
-                return { QFile::ReadError, tr("Unable to read from the source") };
+    discoveredSize.fetchAndAddRelaxed(size);
+    discoveredFileCount.fetchAndAddRelaxed(files.size());
+    {
+        QMutexLocker locker(&manifestMutex);
+        if (!files.isEmpty()) {
+            int directory = manifest.addDirectory(relativePath);
+            for (auto fileInfo : files) {
+                discoveredEntries.enqueue(manifest.addEntry(directory, fileInfo.fileName(), fileInfo.size(), fileInfo.permissions()));
             }
-        } // Output file opened (ReadWrite)
-    } // source file opened (ReadOnly)
+        }
+        pendingDirectoryCount += subdirectoriesPath.size() - 1; // subdirectories pending, this one done
+    }
+    discoveryCondition.wakeAll();
 
-    QFile::setPermissions(origin, in.permissions());
-    in.close();
-    out.close();
-    return { QFile::NoError, QString() };
+    for (auto subdirectoryPath : subdirectoriesPath) {
+        QtConcurrent::run(&discoveryPool, [this, subdirectoryPath]() {
+            findFilesInDirectory(subdirectoryPath);
+        });
+    }
 }
 
-void Installer::revertInstallation()
+bool Installer::takeDiscoveredEntry(int *entry)
 {
-    // TODO: Revert also Desktop, Start Menu and Control Panel entries, etc.
-    for (auto fileInfo : extractedFiles) {
-        QFile f(fileInfo.filePath());
-        qint64 size = fileInfo.size();
-        if (!f.remove()) {
-            emit reversionFailed();
-            return;
-        }
-        extractedSize -= size;
-        QDir d(fileInfo.path());
-        if (d.isEmpty()) {
-            d.rmpath(d.path());
+    QMutexLocker locker(&manifestMutex);
+    while (discoveredEntries.isEmpty()) {
+        if (pendingDirectoryCount == 0 || cancellation.isCanceled() || discoveryError.first != QFile::NoError) {
+            return false;
         }
+        discoveryCondition.wait(&manifestMutex, discoveryPollInterval); // wake up from time to time to check cancellation
     }
-    // This should not be neccessary... but just in case...
-    QDir installDir(installationPath);
-    installDir.removeRecursively();
+    *entry = discoveredEntries.dequeue();
+    return true;
 }
 
-//! Access descriptors
-
-QString Installer::getDataPath() const
+bool Installer::readPayload()
 {
-    return dataPath;
-}
+    Tracer::Scope scanScope(tracer, Tracer::Scan, payloadPath);
+    payload.setFileName(payloadPath);
+    if (!payload.open()) {
+        emit extractionError(QFile::OpenError, payload.errorString());
+        return false;
+    }
 
-void Installer::setDataPath(const QString &value)
-{
-    dataPath = value;
+    // The payload knows its own size, no directory walking needed
+    const QVector<Payload::Entry> &entries = payload.entries();
+    QMutexLocker locker(&manifestMutex);
+    manifest.reserve(manifest.entryCount() + entries.size());
+    qint64 size = 0;
+    int fileCount = 0;
+    payloadManifestEntries.fill(-1, entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+        if (!components.isEmpty() && !components.isInstalled(components.componentOf(entries.at(i).path))) {
+            continue;
+        }
+        payloadManifestEntries[i] = manifest.addEntry(entries.at(i).path, entries.at(i).size, entries.at(i).permissions, Manifest::FromPayload, i);
+        size += entries.at(i).size;
+        fileCount++;
+    }
+    discoveredSize.fetchAndAddRelaxed(size);
+    discoveredFileCount.fetchAndAddRelaxed(fileCount);
+    return true;
 }
 
-QString Installer::getInstallationPath() const
+bool Installer::isFileUpToDate(const QString &origin, const QString &destination, qint64 size, int payloadEntry)
 {
-    return installationPath;
+    if (QFileInfo(destination).size() != size) {
+        return false;
+    }
+
+    BufferPool::Lease buffer(bufferPool);
+    quint64 installedChecksum;
+    quint64 expectedChecksum;
+    if (!hashFile(destination, &buffer.data, cancellation, &installedChecksum)) {
+        return false;
+    }
+    if (payloadEntry >= 0) {
+        expectedChecksum = payload.entries().at(payloadEntry).checksum;
+    } else if (!hashFile(origin, &buffer.data, cancellation, &expectedChecksum)) {
+        return false;
+    }
+    return installedChecksum == expectedChecksum;
 }
 
-void Installer::setInstallationPath(const QString &value)
+bool Installer::removeObsoleteFiles()
 {
-    if (installationPath != value) {
-        installationPath = value;
-        validateInstallationPath();
-        emit installationPathChanged(value);
+    QFile list(extractionRoot + installedFilesListName);
+    if (!list.exists()) {
+        return true; // installed by a version that did not keep the list, nothing is known to be obsolete
+    } else if (!list.open(QIODevice::ReadOnly)) {
+        emit extractionError(list.error(), list.errorString());
+        return false;
+    }
+
+    QSet<QString> currentPaths;
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        if (!manifest.testFlag(entry, Manifest::Additional)) {
+            currentPaths << manifest.entryPath(entry);
+        }
+    }
+
+    QDir d;
+    while (!list.atEnd()) {
+        QByteArray line = list.readLine();
+        QString path = QString::fromUtf8(line.endsWith('\n') ? line.left(line.size() - 1) : line);
+        if (path.isEmpty() || !QDir::isRelativePath(path) || path.split('/').contains("..") || currentPaths.contains(path)) {
+            continue;
+        }
+        QString filePath = extractionRoot + path;
+        if (QFile::exists(filePath) && !QFile::remove(filePath)) {
+            emit extractionError(QFile::RemoveError, tr("Unable to remove the file: %1").arg(filePath));
+            return false;
+        }
+        QString directoryPath = QFileInfo(filePath).path();
+        if (d.exists(directoryPath) && QDir(directoryPath).isEmpty()) {
+            d.rmpath(directoryPath);
+        }
     }
+    return true;
 }
 
-bool Installer::getInstallationPathIsValid() const
+bool Installer::syncExtractedFiles()
 {
-    return installationPathIsValid;
+    if (durability == NoSync) {
+        return true;
+    }
+    Tracer::Scope syncScope(tracer, Tracer::Sync, extractionRoot);
+
+    // A single syncfs() writes every file back at once where it is available. Elsewhere, and for additional files, which may
+    // be on other file systems, files are synced one by one (unless strict durability did it already), and then the
+    // directories holding them, so their entries survive too
+    bool fileSystemSynced = FileSync::syncFileSystem(extractionRoot);
+    QString rootPath = QDir::cleanPath(extractionRoot);
+    QSet<QString> directories;
+    if (!fileSystemSynced) {
+        directories.insert(QFileInfo(rootPath).path());
+    }
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        bool additional = manifest.testFlag(entry, Manifest::Additional);
+        if (!manifest.testFlag(entry, Manifest::Extracted) || (fileSystemSynced && !additional)) {
+            continue;
+        }
+        QString destination = getDestinationPath(entry);
+        if (durability != StrictSync && !FileSync::syncPath(destination)) {
+            emit extractionError(QFile::WriteError, tr("Unable to write the file to the disk: %1").arg(destination));
+            return false;
+        }
+        QString directory = QFileInfo(destination).path();
+        while (!directories.contains(directory)) {
+            directories.insert(directory);
+            if (additional || directory.length() <= rootPath.length()) {
+                break;
+            }
+            directory = QFileInfo(directory).path();
+        }
+    }
+    for (auto directory : directories) {
+        if (!FileSync::syncPath(directory)) {
+            emit extractionError(QFile::WriteError, tr("Unable to write the directory to the disk: %1").arg(directory));
+            return false;
+        }
+    }
+    return true;
 }
 
-void Installer::setInstallationPathIsValid(bool value) // private
+bool Installer::replaceInstalledFiles()
 {
-    if (installationPathIsValid != value) {
-        installationPathIsValid = value;
-        emit installationPathIsValidChanged(value);
+    // The new versions are on the disk, each one replaces its previous version in a single step
+    QSet<QString> directories;
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        if (!manifest.testFlag(entry, Manifest::Replaced) || !manifest.testFlag(entry, Manifest::Extracted)) {
+            continue;
+        }
+        QString installedPath = getInstalledPath(entry);
+        if (!FileLink::replace(getDestinationPath(entry), installedPath)) {
+            emit extractionError(QFile::RenameError, tr("Unable to replace the file: %1").arg(installedPath));
+            return false;
+        }
+        directories.insert(QFileInfo(installedPath).path());
+    }
+    if (durability == NoSync) {
+        return true;
+    }
+    for (auto directory : directories) {
+        if (!FileSync::syncPath(directory)) {
+            emit extractionError(QFile::WriteError, tr("Unable to write the directory to the disk: %1").arg(directory));
+            return false;
+        }
     }
+    return true;
 }
 
-Installer::InstallationPathError Installer::getInstallationPathError() const
+void Installer::removeReplacementFiles()
 {
-    return installationPathError;
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        if (manifest.testFlag(entry, Manifest::Replaced)) {
+            QString replacement = getDestinationPath(entry);
+            if (QFile::exists(replacement) && !QFile::remove(replacement)) {
+                qWarning("Cannot remove '%s'", qPrintable(replacement));
+            }
+        }
+    }
 }
 
-void Installer::setInstallationPathError(const InstallationPathError &value) // private
+bool Installer::writeInstalledFilesList()
 {
-    if (installationPathError != value) {
-        installationPathError = value;
-        setInstallationPathErrorString(installationPathErrorMap[value]);
-        emit installationPathErrorChanged(value);
+    QSaveFile list(extractionRoot + installedFilesListName);
+    if (!list.open(QIODevice::WriteOnly)) {
+        emit extractionError(list.error(), list.errorString());
+        return false;
+    }
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        if (!manifest.testFlag(entry, Manifest::Additional)) {
+            list.write(manifest.entryPath(entry).toUtf8() + '\n');
+        }
     }
+    Tracer::Scope syncScope(tracer, Tracer::Sync, list.fileName()); // QSaveFile flushes the file to disk
+    if (!list.commit()) {
+        emit extractionError(list.error(), list.errorString());
+        return false;
+    }
+    return true;
 }
 
-QString Installer::getInstallationPathErrorString() const
+QString Installer::getOriginPath(int entry) const // private, manifestMutex must be locked while workers run
 {
-    return installationPathErrorString;
+    if (manifest.testFlag(entry, Manifest::Additional)) {
+        return additionalFiles.at(manifest.entrySource(entry)).first;
+    } else if (manifest.testFlag(entry, Manifest::FromPayload)) {
+        return payloadPath;
+    }
+    return dataPath + '/' + manifest.entryPath(entry);
 }
 
-void Installer::setInstallationPathErrorString(const QString &value) // private
+QString Installer::getDestinationPath(int entry) const // private, manifestMutex must be locked while workers run
 {
-    if (installationPathErrorString != value) {
-        installationPathErrorString = value;
-        emit installationPathErrorStringChanged(value);
+    // Updates write the new version of a file next to the installed one
+    if (manifest.testFlag(entry, Manifest::Replaced)) {
+        return Journal::replacementPath(getInstalledPath(entry));
     }
+    return getInstalledPath(entry);
 }
 
-qint64 Installer::getTotalSize() const
+QString Installer::getInstalledPath(int entry) const // private, manifestMutex must be locked while workers run
 {
-    return totalSize;
+    if (manifest.testFlag(entry, Manifest::Additional)) {
+        return manifest.entryPath(entry);
+    }
+    return extractionRoot + manifest.entryPath(entry);
 }
 
-void Installer::setTotalSize(const qint64 &value) // private
+bool Installer::recoverInstallation()
 {
-    if (totalSize != value) {
-        totalSize = value;
-        emit totalSizeChanged(value);
+    if (installerStatus != Idle && installerStatus != ErrorOccurred && installerStatus != ExtractionCanceled && installerStatus != ExtractionFinished
+        && installerStatus != ExtractionSuspended) {
+        qCritical("An installation can't be recovered while the installer is running");
+        return false;
+    } else if (!journal.recover(installationPath)) {
+        qWarning("Unable to recover the installation: %s", qPrintable(journal.errorString()));
+        return false;
     }
+    return true;
 }
 
-QOperatingSystemVersion::OSType Installer::getCurrentOS()
+QFuture<QStringList> Installer::verifyInstallationAsync()
 {
-    return currentOS;
+    return QtConcurrent::run([this]() {
+        return verifyInstallation();
+    });
 }
 
-Installer::InstallerStatus Installer::getInstallerStatus() const
+QStringList Installer::verifyInstallation()
 {
-    return installerStatus;
+    if (installerStatus != Idle && installerStatus != ErrorOccurred && installerStatus != ExtractionCanceled && installerStatus != ExtractionFinished
+        && installerStatus != ExtractionSuspended) {
+        qCritical("An installation can't be verified while the installer is running");
+        return QStringList(installationPath);
+    }
+
+    // cancel() and pause() stop the verification too
+    cancellation.reset();
+    QString root = QDir::cleanPath(installationPath) + '/';
+    QStringList mismatchedFiles;
+    QByteArray buffer;
+    buffer.reserve(verificationBufferSize);
+    auto verifyFile = [&](const QString &origin, const QString &destination, qint64 size, const quint64 *checksum) {
+        if (!cancellation.checkpoint()) {
+            return;
+        }
+        quint64 installedChecksum;
+        quint64 expectedChecksum;
+        if (QFileInfo(destination).size() != size || !hashFile(destination, &buffer, cancellation, &installedChecksum)) {
+            mismatchedFiles << destination;
+        } else if (!checksum && !hashFile(origin, &buffer, cancellation, &expectedChecksum)) {
+            qWarning("Unable to read the file '%s'", qPrintable(origin));
+            mismatchedFiles << origin;
+        } else if (installedChecksum != (checksum ? *checksum : expectedChecksum)) {
+            mismatchedFiles << destination;
+        }
+    };
+
+    if (QFile::exists(payloadPath)) {
+        // A payload of its own, the one of the installer may be in use by an extraction
+        Payload source(payloadPath);
+        if (!source.open()) {
+            qWarning("Unable to read the payload: %s", qPrintable(source.errorString()));
+            return QStringList(payloadPath);
+        }
+        for (const auto &entry : source.entries()) {
+            verifyFile(payloadPath, root + entry.path, entry.size, &entry.checksum);
+        }
+    } else if (QFileInfo(dataPath).isDir()) {
+        QDirIterator it(dataPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            QString origin = it.next();
+            verifyFile(origin, root + QDir(dataPath).relativeFilePath(origin), it.fileInfo().size(), nullptr);
+        }
+    } else {
+        qWarning("Unable to read the data directory '%s'", qPrintable(dataPath));
+        return QStringList(dataPath);
+    }
+
+    for (auto file : additionalFiles) {
+        verifyFile(file.first, file.second, QFileInfo(file.first).size(), nullptr);
+    }
+    if (cancellation.isCanceled()) {
+        qWarning("The verification of the installation was canceled");
+        return QStringList(installationPath);
+    }
+    return mismatchedFiles;
+}
+
+bool Installer::exportTrace(const QString &filePath)
+{
+    QString errorString;
+    if (!tracer.writeChromeTrace(filePath, &errorString)) {
+        qWarning("Unable to export the trace: %s", qPrintable(errorString));
+        return false;
+    }
+    return true;
+}
+
+bool Installer::addComponent(const QString &name, const QString &path, const QStringList &dependencies, bool optional)
+{
+    if (installerStatus != Idle) {
+        qCritical("Components can only be added in IDLE installer status");
+        return false;
+    }
+
+    ComponentSet::Component component;
+    component.name = name;
+    component.path = path;
+    component.dependencies = dependencies;
+    component.optional = optional;
+    QString errorString;
+    if (!components.add(component, &errorString)) {
+        qCritical("%s", qPrintable(errorString));
+        return false;
+    }
+    emit progressChanged();
+    return true;
+}
+
+bool Installer::setComponentSelected(const QString &name, bool selected)
+{
+    if (installerStatus != Idle) {
+        qCritical("Components can only be selected in IDLE installer status");
+        return false;
+    }
+
+    QString errorString;
+    if (!components.setSelected(name, selected, &errorString)) {
+        qCritical("%s", qPrintable(errorString));
+        return false;
+    }
+    emit progressChanged();
+    return true;
+}
+
+bool Installer::addFileToExtract(const QString &from, const QString &to)
+{
+    if (installerStatus != Idle) {
+        qCritical("Files can only be added in IDLE installer status");
+        return false;
+    } else if (!QFile::exists(from)) {
+        qCritical("File \'%s\' doesn't exists", qPrintable(from));
+        return false;
+    }
+
+    additionalFiles << QPair<QString, QString>(from, to);
+    return true;
+}
+
+void Installer::setupBufferPool()
+{
+    // Every worker may hold two buffers at once (e.g. a pack and the one hashing an installed file), fewer could deadlock.
+    // Chunks cannot be split, so payloads need buffers as big as their largest chunk. Payload::open() rejects chunks over
+    // Payload::chunkSizeLimit, so bounding the size by it never truncates a buffer and keeps it within an int
+    int minBufferCount = 2 * qMax(1, maxConcurrentExtractions);
+    qint64 bufferSize = payload.isOpen()
+            ? qBound<qint64>(minPayloadBufferSize, payload.maxChunkSize(), Payload::chunkSizeLimit)
+            : qBound(minCopyBufferSize, memoryLimit / minBufferCount, maxCopyBufferSize);
+    int bufferCount = int(qBound<qint64>(minBufferCount, memoryLimit / bufferSize, std::numeric_limits<int>::max()));
+    if (bufferCount * bufferSize > memoryLimit) {
+        qWarning("The memory limit (%lld bytes) is too low for %d concurrent extractions, %lld bytes are used",
+                 memoryLimit, maxConcurrentExtractions, bufferCount * bufferSize);
+    }
+    bufferPool.reset(bufferCount, int(bufferSize));
+}
+
+bool Installer::extractFiles()
+{
+    setupBufferPool();
+    bool extracted;
+    if (!components.isEmpty()) {
+        extracted = extractComponents();
+    } else if (payload.isOpen()) {
+        QVector<int> entries;
+        entries.reserve(manifest.entryCount() - additionalFiles.size());
+        for (int entry = additionalFiles.size(); entry < manifest.entryCount(); entry++) {
+            entries.append(entry);
+        }
+        extracted = extractPayloadEntries(entries);
+    } else {
+        extracted = extractDiscoveredFiles();
+    }
+
+    // extract additional files
+    extracted = extracted && extractEntries(0, additionalFiles.size());
+
+    if (cancellation.isCanceled()) {
+        // Suspended installations are left as they are, to be resumed
+        if (!suspendRequested.loadAcquire()) {
+            revertInstallation();
+        }
+        return false;
+    }
+    // Transactional updates have their new versions renamed into place by the commit, and only delete obsolete files
+    // once it is done, so a rollback restores the previous installation
+    bool transactionalUpdate = updateMode && journal.isActive();
+    if (extracted && transactionalUpdate) {
+        extracted = syncExtractedFiles();
+    } else if (extracted) {
+        extracted = (!updateMode || removeObsoleteFiles()) && syncExtractedFiles() && (!updateMode || replaceInstalledFiles())
+                    && writeInstalledFilesList();
+    } else if (updateMode && !checkpoint.isActive() && !journal.isActive()) {
+        removeReplacementFiles(); // nothing resumes them
+    }
+    if (extracted && !checkpoint.remove()) {
+        qWarning("Unable to remove the installation checkpoint: %s", qPrintable(checkpoint.errorString()));
+    }
+    if (journal.isActive()) {
+        if (extracted && !journal.commit(durability != NoSync)) {
+            emit extractionError(QFile::RenameError, journal.errorString());
+            extracted = false;
+        }
+        // A failed transaction leaves nothing behind
+        if (!extracted && !journal.rollback()) {
+            qWarning("Unable to roll back the installation: %s", qPrintable(journal.errorString()));
+        }
+    }
+    if (extracted && transactionalUpdate) {
+        extracted = removeObsoleteFiles() && writeInstalledFilesList();
+    }
+    return extracted;
+}
+
+bool Installer::extractDiscoveredFiles()
+{
+    bool extracted = runExtractionWorkers(maxConcurrentExtractions, [&](bool *finished) -> QPair<QFile::FileError, QString> {
+        int entry;
+        if (!takeDiscoveredEntry(&entry)) {
+            *finished = true;
+            return { QFile::NoError, QString() };
+        }
+        QPair<QFile::FileError, QString> singleExtractionResult = extractEntry(entry);
+        if (singleExtractionResult.first != QFile::NoError) {
+            discoveryStopped.storeRelease(1);
+        }
+        return singleExtractionResult;
+    });
+
+    // Discovery tasks may still be running if the extraction failed or was canceled, and they can still create directories
+    discoveryPool.waitForDone();
+    if (extracted && !cancellation.isCanceled() && discoveryError.first != QFile::NoError) {
+        emit extractionError(discoveryError.first, discoveryError.second);
+        return false;
+    }
+    return extracted;
+}
+
+bool Installer::extractPayloadEntries(const QVector<int> &entriesToExtract)
+{
+    // Directories are created once, before any worker starts writing files
+    QPair<QFile::FileError, QString> directoriesResult = makeEntryDirectories(entriesToExtract);
+    if (directoriesResult.first != QFile::NoError) {
+        emit extractionError(directoriesResult.first, directoriesResult.second);
+        return false;
+    }
+
+    QVector<int> batchEntries;
+    QVector<int> batchOffsets;
+    QVector<int> batchPacks;
+    QVector<int> duplicateEntries; // extracted once the rest are, so their originals can be linked
+    batchPayloadEntries(entriesToExtract, &batchEntries, &batchOffsets, &batchPacks, &duplicateEntries);
+    bool useIoUring = canUseIoUring();
+
+    int batchCount = batchOffsets.size() - 1;
+    QAtomicInt nextBatch = 0;
+    bool extracted = runExtractionWorkers(batchCount, [&](bool *finished) -> QPair<QFile::FileError, QString> {
+        int batch = nextBatch.fetchAndAddRelaxed(1);
+        if (batch >= batchCount) {
+            *finished = true;
+            return { QFile::NoError, QString() };
+        }
+        return extractBatch(batchEntries.constData() + batchOffsets.at(batch), batchOffsets.at(batch + 1) - batchOffsets.at(batch),
+                            batchPacks.at(batch), useIoUring);
+    });
+    return extracted && (duplicateEntries.isEmpty() || extractListedEntries(duplicateEntries));
+}
+
+QPair<QFile::FileError, QString> Installer::makeEntryDirectories(const QVector<int> &entries)
+{
+    QVector<bool> directoryCreated(manifest.directoryCount(), false);
+    for (int entry : entries) {
+        int directory = manifest.entryDirectory(entry);
+        if (directoryCreated.at(directory)) {
+            continue;
+        }
+        QString directoryPath = extractionRoot + manifest.directoryPath(directory);
+        Tracer::FileScope directoryScope(tracer, directoryPath); // directories are sampled like files
+        Tracer::Scope mkdirScope(tracer, Tracer::MakeDirectory);
+        if (!directoryCache.makePath(directoryPath)) {
+            return { QFile::PermissionsError, tr("Access denied to create the path: %1").arg(directoryPath) };
+        }
+        directoryCreated[directory] = true;
+    }
+    return { QFile::NoError, QString() };
+}
+
+void Installer::batchPayloadEntries(const QVector<int> &entriesToExtract, QVector<int> *batchEntries, QVector<int> *batchOffsets,
+                                    QVector<int> *batchPacks, QVector<int> *duplicateEntries)
+{
+    // Files packed together are extracted by the same worker, so their pack is decompressed only once.
+    // Every other file is a batch of its own, and larger files go first
+    const QVector<Payload::Entry> &entries = payload.entries();
+    QVector<QVector<int>> packedEntries(payload.packs().size());
+    batchEntries->reserve(entriesToExtract.size());
+    for (int entry : entriesToExtract) {
+        int pack = entries.at(manifest.entrySource(entry)).pack;
+        if (entries.at(manifest.entrySource(entry)).type == Payload::Duplicate) {
+            duplicateEntries->append(entry);
+        } else if (pack >= 0) {
+            packedEntries[pack].append(entry);
+        } else {
+            batchOffsets->append(batchEntries->size());
+            batchEntries->append(entry);
+            batchPacks->append(-1);
+        }
+    }
+    for (int pack = 0; pack < packedEntries.size(); pack++) {
+        if (!packedEntries.at(pack).isEmpty()) {
+            batchOffsets->append(batchEntries->size());
+            *batchEntries += packedEntries.at(pack);
+            batchPacks->append(pack);
+        }
+    }
+    batchOffsets->append(batchEntries->size());
+}
+
+bool Installer::canUseIoUring()
+{
+    if (ioBackend != IoUringBackend) {
+        return false;
+    } else if (!IoUring().isValid()) {
+        qWarning("io_uring is not available, files are written with QFile");
+        return false;
+    }
+    return true;
+}
+
+QPair<QFile::FileError, QString> Installer::extractBatch(const int *entries, int entryCount, int pack, bool useIoUring)
+{
+    IoUring *ring = useIoUring && pack >= 0 ? threadIoUring() : nullptr;
+    if (ring) {
+        return extractPackWithIoUring(pack, entries, entryCount, ring);
+    }
+    QByteArray packData; // takes a buffer of the pool once it is read
+    QPair<QFile::FileError, QString> batchResult = { QFile::NoError, QString() };
+    for (int i = 0; i < entryCount && batchResult.first == QFile::NoError; i++) {
+        if (!cancellation.checkpoint()) {
+            batchResult = { QFile::AbortError, tr("Operation canceled") };
+        } else {
+            batchResult = extractEntry(entries[i], &packData);
+        }
+    }
+    if (!packData.isNull()) {
+        bufferPool.release(&packData);
+    }
+    return batchResult;
+}
+
+bool Installer::extractComponents()
+{
+    // Files are sorted by component once every file is known, so files found in a data directory are not extracted
+    // while the directory is listed
+    if (!payload.isOpen()) {
+        discoveryPool.waitForDone();
+        if (cancellation.isCanceled()) {
+            return false;
+        } else if (discoveryError.first != QFile::NoError) {
+            emit extractionError(discoveryError.first, discoveryError.second);
+            return false;
+        }
+        discoveredEntries.clear();
+    }
+
+    QVector<int> directoryComponents(manifest.directoryCount());
+    for (int directory = 0; directory < manifest.directoryCount(); directory++) {
+        directoryComponents[directory] = components.componentOf(manifest.directoryPath(directory));
+    }
+    int base = components.count(); // scheduled like a component without dependencies
+    QVector<QVector<int>> componentEntries(base + 1);
+    QVector<qint64> componentSizes(base, 0);
+    entryComponents.fill(-1, manifest.entryCount());
+    for (int entry = additionalFiles.size(); entry < manifest.entryCount(); entry++) {
+        int component = directoryComponents.at(manifest.entryDirectory(entry));
+        entryComponents[entry] = component;
+        if (component < 0) {
+            componentEntries[base].append(entry);
+        } else {
+            componentEntries[component].append(entry);
+            componentSizes[component] += manifest.entrySize(entry);
+        }
+    }
+    for (int component = 0; component < base; component++) {
+        components.setSize(component, componentSizes.at(component));
+    }
+
+    // A component starts once its own dependencies are finished, so it never waits for components it does not depend
+    // on. The batches of the started components (files, or files packed together) are taken by the same workers, and
+    // the duplicates of a component follow the rest of it, so their originals can be linked
+    struct ComponentWork {
+        QVector<int> batchEntries;
+        QVector<int> batchOffsets;
+        QVector<int> batchPacks;
+        QVector<int> duplicateEntries;
+        int unfinishedDependencies = 0;
+        int remainingBatches = 0; // queued or being extracted
+        bool started = false;
+        bool duplicatesQueued = false;
+    };
+    QVector<ComponentWork> work(base + 1);
+    int totalBatchCount = 0;
+    for (int component = 0; component <= base; component++) {
+        ComponentWork &componentWork = work[component];
+        if (payload.isOpen()) {
+            batchPayloadEntries(componentEntries.at(component), &componentWork.batchEntries, &componentWork.batchOffsets,
+                                &componentWork.batchPacks, &componentWork.duplicateEntries);
+        } else {
+            componentWork.batchEntries = componentEntries.at(component);
+            for (int i = 0; i <= componentWork.batchEntries.size(); i++) {
+                componentWork.batchOffsets.append(i);
+                componentWork.batchPacks.append(-1);
+            }
+        }
+        componentWork.unfinishedDependencies = component < base ? components.dependencyCount(component) : 0;
+        totalBatchCount += componentWork.batchOffsets.size() - 1 + componentWork.duplicateEntries.size();
+    }
+    bool useIoUring = payload.isOpen() && canUseIoUring();
+
+    QMutex queueMutex; // guards the following variables and work
+    QWaitCondition queueCondition;
+    QQueue<QPair<int, int>> readyBatches; // component and batch, batches past the last one are its duplicates
+    int runningBatches = 0;
+    bool stopped = false;
+
+    // Queues the duplicates of the components once the rest is extracted, and finishes them once everything is, which
+    // makes their dependents ready once all their dependencies are. queueMutex must be locked
+    auto advance = [&](QVector<int> pendingComponents, QVector<int> *readyComponents) {
+        while (!pendingComponents.isEmpty()) {
+            int component = pendingComponents.takeLast();
+            ComponentWork &componentWork = work[component];
+            if (!componentWork.started) {
+                readyComponents->append(component);
+                continue;
+            }
+            int batchCount = componentWork.batchOffsets.size() - 1;
+            if (componentWork.remainingBatches == 0 && !componentWork.duplicatesQueued && !componentWork.duplicateEntries.isEmpty()) {
+                componentWork.duplicatesQueued = true;
+                for (int duplicate = 0; duplicate < componentWork.duplicateEntries.size(); duplicate++) {
+                    readyBatches.enqueue(qMakePair(component, batchCount + duplicate));
+                }
+                componentWork.remainingBatches = componentWork.duplicateEntries.size();
+            }
+            if (componentWork.remainingBatches > 0 || component == base) {
+                continue;
+            }
+            components.setState(component, ComponentSet::Finished);
+            emit componentFinished(components.at(component).name);
+            for (int dependent : components.dependents(component)) {
+                if (--work[dependent].unfinishedDependencies == 0) {
+                    pendingComponents.append(dependent);
+                }
+            }
+        }
+    };
+
+    // Starts the ready components, and those ready once the components without batches are finished. Their directories
+    // are created while queueMutex is unlocked, so the other workers are not stalled. queueMutex must be locked
+    auto start = [&](QVector<int> readyComponents, QMutexLocker &locker) -> QPair<QFile::FileError, QString> {
+        while (!readyComponents.isEmpty() && !stopped) {
+            if (payload.isOpen()) {
+                locker.unlock();
+                for (int component : readyComponents) {
+                    QPair<QFile::FileError, QString> directoriesResult = makeEntryDirectories(componentEntries.at(component));
+                    if (directoriesResult.first != QFile::NoError) {
+                        locker.relock();
+                        return directoriesResult;
+                    }
+                }
+                locker.relock();
+            }
+            QVector<int> startedComponents;
+            startedComponents.swap(readyComponents);
+            for (int i = startedComponents.size() - 1; i >= 0; i--) {
+                int component = startedComponents.at(i);
+                ComponentWork &componentWork = work[component];
+                componentWork.started = true;
+                if (component < base) {
+                    components.setState(component, ComponentSet::Extracting);
+                    emit componentStarted(components.at(component).name);
+                }
+                int batchCount = componentWork.batchOffsets.size() - 1;
+                for (int batch = 0; batch < batchCount; batch++) {
+                    readyBatches.enqueue(qMakePair(component, batch));
+                }
+                componentWork.remainingBatches = batchCount;
+            }
+            queueCondition.wakeAll();
+            advance(startedComponents, &readyComponents);
+        }
+        return { QFile::NoError, QString() };
+    };
+
+    QVector<int> independentComponents;
+    independentComponents.append(base);
+    for (int component = base - 1; component >= 0; component--) {
+        if (components.isInstalled(component) && work.at(component).unfinishedDependencies == 0) {
+            independentComponents.append(component);
+        }
+    }
+    {
+        QMutexLocker locker(&queueMutex);
+        QPair<QFile::FileError, QString> startResult = start(independentComponents, locker);
+        if (startResult.first != QFile::NoError) {
+            emit extractionError(startResult.first, startResult.second);
+            return false;
+        }
+    }
+
+    return runExtractionWorkers(totalBatchCount, [&](bool *finished) -> QPair<QFile::FileError, QString> {
+        QMutexLocker locker(&queueMutex);
+        while (readyBatches.isEmpty() && runningBatches > 0 && !stopped) {
+            queueCondition.wait(&queueMutex);
+        }
+        if (readyBatches.isEmpty() || stopped) {
+            *finished = true;
+            return { QFile::NoError, QString() };
+        }
+        QPair<int, int> next = readyBatches.dequeue();
+        runningBatches++;
+        locker.unlock();
+
+        // The batches of a component are not changed once it is started
+        const ComponentWork &componentWork = work.at(next.first);
+        int batchCount = componentWork.batchOffsets.size() - 1;
+        int batch = next.second;
+        QPair<QFile::FileError, QString> batchResult = batch < batchCount
+            ? extractBatch(componentWork.batchEntries.constData() + componentWork.batchOffsets.at(batch),
+                           componentWork.batchOffsets.at(batch + 1) - componentWork.batchOffsets.at(batch), componentWork.batchPacks.at(batch), useIoUring)
+            : extractEntry(componentWork.duplicateEntries.at(batch - batchCount));
+
+        // The batch is still counted as running while the components it made ready are started, so the other workers
+        // wait for their batches instead of finishing
+        locker.relock();
+        if (batchResult.first == QFile::NoError) {
+            work[next.first].remainingBatches--;
+            QVector<int> readyComponents;
+            advance({ next.first }, &readyComponents);
+            batchResult = start(readyComponents, locker);
+        }
+        runningBatches--;
+        stopped = stopped || batchResult.first != QFile::NoError;
+        queueCondition.wakeAll(); // new batches, or nothing left to wait for
+        return batchResult;
+    });
+}
+
+bool Installer::extractListedEntries(const QVector<int> &entries)
+{
+    QAtomicInt nextEntry = 0;
+    return runExtractionWorkers(entries.size(), [&](bool *finished) -> QPair<QFile::FileError, QString> {
+        int i = nextEntry.fetchAndAddRelaxed(1);
+        if (i >= entries.size()) {
+            *finished = true;
+            return { QFile::NoError, QString() };
+        }
+        return extractEntry(entries.at(i));
+    });
+}
+
+bool Installer::extractEntries(int firstEntry, int entryCount)
+{
+    QAtomicInt nextEntry = 0;
+    return runExtractionWorkers(entryCount, [&](bool *finished) -> QPair<QFile::FileError, QString> {
+        int i = nextEntry.fetchAndAddRelaxed(1);
+        if (i >= entryCount) {
+            *finished = true;
+            return { QFile::NoError, QString() };
+        }
+        return extractEntry(firstEntry + i);
+    });
+}
+
+QPair<QFile::FileError, QString> Installer::extractEntry(int entry, QByteArray *packData)
+{
+    QString path;
+    QString origin;
+    QString installedPath;
+    QString destination;
+    int payloadEntry = -1;
+    bool additional;
+    qint64 size;
+    {
+        QMutexLocker locker(&manifestMutex);
+        path = manifest.entryPath(entry);
+        origin = getOriginPath(entry);
+        installedPath = getInstalledPath(entry);
+        destination = getDestinationPath(entry);
+        if (manifest.testFlag(entry, Manifest::FromPayload)) {
+            payloadEntry = manifest.entrySource(entry);
+        }
+        additional = manifest.testFlag(entry, Manifest::Additional);
+        size = manifest.entrySize(entry);
+    }
+    Tracer::FileScope fileScope(tracer, destination);
+
+    qint64 resumeOffset = 0;
+    if (checkpoint.isResuming() && QFile::exists(destination)) {
+        bool complete;
+        QPair<QFile::FileError, QString> resumeResult = prepareResume(entry, destination, size, payloadEntry, &complete, &resumeOffset);
+        if (resumeResult.first != QFile::NoError || complete) {
+            return resumeResult;
+        }
+    }
+
+    if (updateMode && resumeOffset == 0 && QFile::exists(destination)) {
+        bool upToDate;
+        QPair<QFile::FileError, QString> updateResult = prepareUpdate(entry, origin, destination, size, payloadEntry, &upToDate);
+        if (updateResult.first != QFile::NoError || upToDate) {
+            return updateResult;
+        }
+        QMutexLocker locker(&manifestMutex);
+        destination = getDestinationPath(entry);
+    }
+
+    QPair<QFile::FileError, QString> journalResult = journalFile(installedPath, destination, additional);
+    if (journalResult.first != QFile::NoError) {
+        return journalResult;
+    }
+    // Additional files are written last, so they may be interrupted before any record of them is flushed. Only those
+    // recorded as created by this installation are replaced when it resumes
+    if (additional && !QFile::exists(destination) && !checkpoint.recordCreatedFile(path)) {
+        return { QFile::WriteError, checkpoint.errorString() };
+    }
+
+    QPair<QFile::FileError, QString> singleExtractionResult;
+    if (payloadEntry >= 0 && payload.entries().at(payloadEntry).type == Payload::Duplicate) {
+        singleExtractionResult = extractPayloadDuplicate(payload.entries().at(payloadEntry), destination);
+    } else if (payloadEntry >= 0 && payload.entries().at(payloadEntry).type == Payload::Delta) {
+        singleExtractionResult = extractPayloadDelta(payload.entries().at(payloadEntry), installedPath, destination);
+    } else if (payloadEntry >= 0) {
+        singleExtractionResult = extractPayloadEntry(payload.entries().at(payloadEntry), destination, packData, resumeOffset);
+    } else {
+        singleExtractionResult = extractSingleFile(origin, destination);
+    }
+    if (singleExtractionResult.first == QFile::NoError) {
+        {
+            QMutexLocker locker(&manifestMutex);
+            manifest.setFlag(entry, Manifest::Extracted);
+            extractedFileCount.fetchAndAddRelaxed(1);
+            components.addProcessedSize(entryComponents.value(entry, -1), size);
+        }
+        // The checkpoint is written by the first worker that finds it due
+        checkpoint.recordFile(path, destination != installedPath ? Journal::replacementPath(path) : QString());
+        if (!checkpoint.flushIfDue()) {
+            return { QFile::WriteError, checkpoint.errorString() };
+        }
+    }
+    return singleExtractionResult;
+}
+
+QPair<QFile::FileError, QString> Installer::journalFile(const QString &installedPath, const QString &destination, bool additional)
+{
+    // Files written outside of the staging directory are journaled one by one: additional files, and every file of an
+    // update. New versions of installed files are renamed over them on commit. Existing files are not journaled, the
+    // extraction fails anyway and they must survive a rollback
+    if (!journal.isActive() || (!additional && !updateMode)) {
+        return { QFile::NoError, QString() };
+    }
+    bool journaled = true;
+    if (destination != installedPath) {
+        journaled = journal.recordReplacement(installedPath);
+    } else if (!QFile::exists(destination)) {
+        journaled = journal.recordFile(destination);
+    }
+    if (!journaled) {
+        return { QFile::WriteError, journal.errorString() };
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::prepareUpdate(int entry, const QString &origin, const QString &destination, qint64 size, int payloadEntry, bool *upToDate)
+{
+    // Updates leave unchanged files untouched. Changed files are written next to the installed ones, which stay until
+    // the update is complete, so a canceled update keeps them. A new version left by an interrupted update is written again
+    *upToDate = isFileUpToDate(origin, destination, size, payloadEntry);
+    QString replacement = Journal::replacementPath(destination);
+    if (!*upToDate && QFile::exists(replacement) && !QFile::remove(replacement)) {
+        return { QFile::RemoveError, tr("Unable to remove the file: %1").arg(replacement) };
+    }
+    QMutexLocker locker(&manifestMutex);
+    manifest.setFlag(entry, *upToDate ? Manifest::Unchanged : Manifest::Replaced);
+    if (*upToDate) {
+        extractedSize.fetchAndAddRelaxed(size);
+        components.addProcessedSize(entryComponents.value(entry, -1), size);
+        extractedFileCount.fetchAndAddRelaxed(1);
+        checkpoint.recordFile(manifest.entryPath(entry));
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::prepareResume(int entry, const QString &destination, qint64 size, int payloadEntry, bool *complete, qint64 *resumeOffset)
+{
+    // Files are recorded once they are on the disk, so a recorded file of the right size is complete. Large payload files
+    // continue from their last record, if it ends on a chunk and the chunks have their own checksums.
+    // Anything else was being written when the installation stopped, and is extracted again
+    QString path;
+    bool additional;
+    {
+        QMutexLocker locker(&manifestMutex);
+        path = manifest.entryPath(entry);
+        additional = manifest.testFlag(entry, Manifest::Additional);
+    }
+    *resumeOffset = 0;
+    if (updateMode) {
+        return prepareUpdateResume(entry, path, destination, size, complete);
+    }
+    qint64 installedSize = QFileInfo(destination).size();
+    *complete = checkpoint.isComplete(path) && installedSize == size;
+    if (*complete) {
+        QMutexLocker locker(&manifestMutex);
+        manifest.setFlag(entry, Manifest::Extracted);
+        extractedSize.fetchAndAddRelaxed(size);
+        components.addProcessedSize(entryComponents.value(entry, -1), size);
+        extractedFileCount.fetchAndAddRelaxed(1);
+        return { QFile::NoError, QString() };
+    }
+
+    qint64 offset = checkpoint.resumeOffset(path);
+    if (offset > 0 && offset <= installedSize && payloadEntry >= 0 && payload.hasChunkChecksums()) {
+        const Payload::Entry &payloadFile = payload.entries().at(payloadEntry);
+        qint64 chunkEnd = 0;
+        for (int chunk = 0; chunk < payloadFile.chunks.size() && chunkEnd < offset; chunk++) {
+            chunkEnd += payloadFile.chunks.at(chunk).size;
+        }
+        if (payloadFile.type == Payload::File && payloadFile.pack < 0 && chunkEnd == offset) {
+            *resumeOffset = offset;
+            extractedSize.fetchAndAddRelaxed(offset);
+            return { QFile::NoError, QString() };
+        }
+    }
+    // Additional files may not be ours, they are only removed if this installation created them
+    if ((!additional || checkpoint.isCreated(path)) && !QFile::remove(destination)) {
+        return { QFile::RemoveError, tr("Unable to replace the file: %1").arg(destination) };
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::prepareUpdateResume(int entry, const QString &path, const QString &destination, qint64 size, bool *complete)
+{
+    // Updates write changed files next to the installed ones, and never continue them. A recorded file whose new version
+    // is gone was up to date, or was moved in place already. Anything else is compared with its new version again
+    QString replacement = Journal::replacementPath(destination);
+    bool replaced = QFile::exists(replacement);
+    *complete = checkpoint.isComplete(path) && QFileInfo(replaced ? replacement : destination).size() == size;
+    if (*complete) {
+        QMutexLocker locker(&manifestMutex);
+        manifest.setFlag(entry, replaced ? Manifest::Replaced : Manifest::Unchanged);
+        if (replaced) {
+            manifest.setFlag(entry, Manifest::Extracted);
+        }
+        extractedSize.fetchAndAddRelaxed(size);
+        components.addProcessedSize(entryComponents.value(entry, -1), size);
+        extractedFileCount.fetchAndAddRelaxed(1);
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::extractPackWithIoUring(int pack, const int *packEntries, int entryCount, IoUring *ring)
+{
+    // The files to write are collected first, then opened, written and closed together
+    QVector<int> pendingEntries;
+    QVector<quint32> packOffsets;
+    QVector<IoUring::FileWrite> writes;
+    pendingEntries.reserve(entryCount);
+    packOffsets.reserve(entryCount);
+    writes.reserve(entryCount);
+    for (int i = 0; i < entryCount; i++) {
+        if (!cancellation.checkpoint()) {
+            return { QFile::AbortError, tr("Operation canceled") };
+        }
+        int entry = packEntries[i];
+        QString installedPath;
+        QString destination;
+        int payloadEntry;
+        {
+            QMutexLocker locker(&manifestMutex);
+            installedPath = getInstalledPath(entry);
+            destination = getDestinationPath(entry);
+            payloadEntry = manifest.entrySource(entry);
+        }
+        const Payload::Entry &packedEntry = payload.entries().at(payloadEntry);
+        if (checkpoint.isResuming() && QFile::exists(destination)) {
+            bool complete;
+            qint64 resumeOffset; // packed files are small, they are never continued
+            QPair<QFile::FileError, QString> resumeResult = prepareResume(entry, destination, packedEntry.size, payloadEntry, &complete, &resumeOffset);
+            if (resumeResult.first != QFile::NoError) {
+                return resumeResult;
+            } else if (complete) {
+                continue;
+            }
+        }
+        if (updateMode && QFile::exists(destination)) {
+            bool upToDate;
+            QPair<QFile::FileError, QString> updateResult = prepareUpdate(entry, QString(), destination, packedEntry.size, payloadEntry, &upToDate);
+            if (updateResult.first != QFile::NoError) {
+                return updateResult;
+            } else if (upToDate) {
+                continue;
+            }
+            QMutexLocker locker(&manifestMutex);
+            destination = getDestinationPath(entry);
+        }
+        QPair<QFile::FileError, QString> journalResult = journalFile(installedPath, destination, false);
+        if (journalResult.first != QFile::NoError) {
+            return journalResult;
+        }
+
+        IoUring::FileWrite write;
+        write.path = QFile::encodeName(destination);
+        write.size = packedEntry.size;
+        write.mode = posixMode(packedEntry.permissions);
+        write.sync = durability == StrictSync;
+        writes.append(write);
+        pendingEntries.append(entry);
+        packOffsets.append(packedEntry.packOffset);
+    }
+    if (writes.isEmpty()) {
+        return { QFile::NoError, QString() };
+    }
+
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    bufferPool.reserve();
+    QByteArray packData = takeChunkBuffer(payload.packs().at(pack));
+    QString errorString;
+    if (!payload.readChunk(payload.packs().at(pack), &packData, &errorString)) {
+        bufferPool.release(&packData);
+        return { QFile::ReadError, errorString.isNull() ? tr("Unable to read from the payload") : errorString };
+    }
+    for (int i = 0; i < writes.size(); i++) {
+        writes[i].data = packData.constData() + packOffsets.at(i);
+    }
+    ring->writeFiles(writes.data(), writes.size()); // every file has its own result, even if the ring failed
+    bufferPool.release(&packData);
+    copyScope.stop();
+
+    // Files written before a failure still count, so they are reverted
+    QPair<QFile::FileError, QString> firstError = { QFile::NoError, QString() };
+    QMutexLocker locker(&manifestMutex);
+    for (int i = 0; i < writes.size(); i++) {
+        const IoUring::FileWrite &write = writes.at(i);
+        if (write.error == 0) {
+            manifest.setFlag(pendingEntries.at(i), Manifest::Extracted);
+            extractedSize.fetchAndAddRelaxed(write.size);
+            extractedFileCount.fetchAndAddRelaxed(1);
+            components.addProcessedSize(entryComponents.value(pendingEntries.at(i), -1), write.size);
+            QString path = manifest.entryPath(pendingEntries.at(i));
+            checkpoint.recordFile(path, manifest.testFlag(pendingEntries.at(i), Manifest::Replaced) ? Journal::replacementPath(path) : QString());
+        } else if (firstError.first == QFile::NoError) {
+            QString destination = QFile::decodeName(write.path);
+            if (write.failedOperation == IoUring::Open && write.error == EEXIST) {
+                firstError = { QFile::CopyError, tr("Destination file exists: %1").arg(destination) };
+            } else if (write.failedOperation == IoUring::Open) {
+                firstError = { QFile::OpenError, tr("Unable to create the file %1: %2").arg(destination, qt_error_string(write.error)) };
+            } else if (write.failedOperation == IoUring::SetPermissions) {
+                firstError = { QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, qt_error_string(write.error)) };
+            } else if (write.failedOperation == IoUring::Sync) {
+                firstError = { QFile::WriteError, tr("Unable to write the file to the disk: %1").arg(destination) };
+            } else {
+                firstError = { QFile::WriteError, tr("Failure to write block: %1").arg(qt_error_string(write.error)) };
+            }
+        }
+    }
+    locker.unlock();
+    if (firstError.first == QFile::NoError && !checkpoint.flushIfDue()) {
+        return { QFile::WriteError, checkpoint.errorString() };
+    }
+    return firstError;
+}
+
+bool Installer::runExtractionWorkers(int maxWorkerCount, const std::function<QPair<QFile::FileError, QString> (bool *)> &extractNext)
+{
+    QAtomicInt failed = 0;
+    QPair<QFile::FileError, QString> firstError;
+
+    // Every worker extracts the next pending file until there are no more, an error occurs or the extraction is canceled
+    auto worker = [&]() {
+        forever {
+            if (!cancellation.checkpoint() || failed.loadAcquire()) {
+                return;
+            }
+            bool finished = false;
+            QPair<QFile::FileError, QString> singleExtractionResult = extractNext(&finished);
+            if (finished) {
+                return;
+            }
+            if (singleExtractionResult.first != QFile::NoError) {
+                if (!cancellation.isCanceled() && failed.testAndSetOrdered(0, 1)) {
+                    firstError = singleExtractionResult;
+                }
+                return;
+            }
+        }
+    };
+
+    int workerCount = qBound(1, maxConcurrentExtractions, maxWorkerCount);
+    QList<QFuture<void>> workers;
+    for (int i = 1; i < workerCount; i++) {
+        workers << QtConcurrent::run(&extractionPool, worker);
+    }
+    worker(); // the current thread is a worker too
+    for (auto future : workers) {
+        future.waitForFinished();
+    }
+
+    if (cancellation.isCanceled()) {
+        return false; // reverted by extractFiles()
+    } else if (failed.loadAcquire()) {
+        emit extractionError(firstError.first, firstError.second);
+        return false;
+    }
+    return true;
+}
+
+QPair<QFile::FileError, QString> Installer::extractSingleFile(const QString &origin, const QString &destination)
+{
+    QFile in(origin);
+    QFile out(destination);
+
+    if (origin.isEmpty()) {
+        return { QFile::FatalError, tr("Empty or null source file name: %1").arg(origin) };
+    }
+    if (QFile::exists(destination)) {
+        return { QFile::CopyError, tr("Destination file exists: %1").arg(destination) };
+    }
+    Tracer::Scope openScope(tracer, Tracer::Open);
+    if (!in.open(QFile::ReadOnly | QFile::Unbuffered)) {
+        return { in.error(), in.errorString() };
+    }
+    if (!out.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        in.close();
+        return { out.error(), out.errorString() };
+    }
+    openScope.stop();
+
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    QPair<QFile::FileError, QString> copyResult = copyFileContents(in, out);
+    copyScope.stop();
+    if (copyResult.first != QFile::NoError) {
+        in.close();
+        out.close();
+        out.remove();
+        return copyResult;
+    }
+
+    // Resources are read-only, the owner keeps write access so the installation can be updated and removed
+    Tracer::Scope permissionsScope(tracer, Tracer::SetPermissions);
+    if (!out.setPermissions(in.permissions() | QFile::WriteOwner | QFile::WriteUser)) {
+        QPair<QFile::FileError, QString> permissionsResult = { QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, out.errorString()) };
+        in.close();
+        out.close();
+        out.remove();
+        return permissionsResult;
+    }
+    permissionsScope.stop();
+    QPair<QFile::FileError, QString> flushResult = flushExtractedFile(out, in.size());
+    in.close();
+    if (flushResult.first != QFile::NoError) {
+        out.close();
+        out.remove();
+        return flushResult;
+    }
+    out.close();
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::copyFileContents(QFile &in, QFile &out)
+{
+    if (in.fileName().startsWith(':')) {
+        // Uncompressed resources are mapped in memory, so there is no need to read them through a QIODevice
+        QResource resource(in.fileName());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+        bool resourceIsCompressed = resource.compressionAlgorithm() != QResource::NoCompression;
+#else
+        bool resourceIsCompressed = resource.isCompressed();
+#endif
+        if (resource.isValid() && !resourceIsCompressed && resource.data()) {
+            return copyFromMemory(reinterpret_cast<const char *>(resource.data()), resource.size(), out);
+        }
+    } else {
+        bool handled = false;
+        QPair<QFile::FileError, QString> kernelCopyResult = copyWithKernel(in, out, &handled);
+        if (handled) {
+            return kernelCopyResult;
+        }
+    }
+    return copyWithBuffer(in, out);
+}
+
+QPair<QFile::FileError, QString> Installer::copyFromMemory(const char *data, qint64 size, QFile &out)
+{
+    FileSync::preallocate(out, size);
+    qint64 bytesCopied = 0;
+    while (bytesCopied < size) {
+        if (!cancellation.checkpoint()) {
+            return { QFile::AbortError, tr("Operation canceled") };
+        }
+        qint64 blockSize = qMin(size - bytesCopied, maxCopyBufferSize);
+        if (blockSize != out.write(data + bytesCopied, blockSize)) {
+            return { QFile::WriteError, tr("Failure to write block") };
+        }
+        bytesCopied += blockSize;
+        extractedSize.fetchAndAddRelaxed(blockSize);
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::copyWithKernel(QFile &in, QFile &out, bool *handled)
+{
+    *handled = false;
+#ifdef Q_OS_LINUX
+    int inFd = in.handle();
+    int outFd = out.handle();
+    if (inFd < 0 || outFd < 0) {
+        return { QFile::NoError, QString() };
+    }
+    const qint64 size = in.size();
+
+#ifdef FICLONE
+    // On copy-on-write filesystems (Btrfs, XFS...) the whole file is shared instead of copied
+    if (ioctl(outFd, FICLONE, inFd) == 0) {
+        *handled = true;
+        extractedSize.fetchAndAddRelaxed(size);
+        return { QFile::NoError, QString() };
+    }
+#endif
+
+    // Copy in chunks, so cancellation and progress are still checked while the kernel does the work
+    loff_t offset = 0;
+    bool useSendfile = !hasCopyFileRange;
+    while (offset < size) {
+        if (!cancellation.checkpoint()) {
+            *handled = true;
+            return { QFile::AbortError, tr("Operation canceled") };
+        }
+        size_t chunkSize = size_t(qMin(size - offset, kernelCopyChunkSize));
+        ssize_t copied = -1;
+        if (!useSendfile) {
+#ifdef SIF_HAS_COPY_FILE_RANGE
+            loff_t outOffset = offset;
+            copied = copy_file_range(inFd, &offset, outFd, &outOffset, chunkSize, 0);
+#endif
+            if (copied <= 0 && offset == 0 && (copied == 0 || errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP || errno == EBADF)) {
+                useSendfile = true; // not supported between these files or filesystems
+                continue;
+            }
+        } else {
+            off_t sendfileOffset = off_t(offset);
+            copied = sendfile(outFd, inFd, &sendfileOffset, chunkSize);
+            if (copied <= 0 && offset == 0 && (copied == 0 || errno == EINVAL || errno == ENOSYS)) {
+                return { QFile::NoError, QString() }; // let the buffered copy do the work
+            }
+            if (copied > 0) {
+                offset = loff_t(sendfileOffset);
+            }
+        }
+
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        *handled = true;
+        if (copied < 0) {
+            return { QFile::WriteError, tr("Failure to write block: %1").arg(qt_error_string(errno)) };
+        } else if (copied == 0) {
+            break; // the source is shorter than expected
+        }
+        extractedSize.fetchAndAddRelaxed(copied);
+    }
+
+    *handled = true;
+    if (offset != size) {
+        return { QFile::ReadError, tr("Unable to read from the source") };
+    }
+#else
+    Q_UNUSED(in)
+    Q_UNUSED(out)
+#endif
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::copyWithBuffer(QFile &in, QFile &out)
+{
+    FileSync::adviseSequentialRead(in, in.size());
+    FileSync::preallocate(out, in.size());
+
+    // Blocks come from the buffer pool, which waits for a free one when the memory limit is reached
+    BufferPool::Lease block(bufferPool);
+    block.data.resize(block.data.capacity());
+    qint64 bytesCopied = 0;
+    while (!in.atEnd()) {
+        if (!cancellation.checkpoint()) {
+            return { QFile::AbortError, tr("Operation canceled") };
+        }
+        qint64 inFlow = in.read(block.data.data(), block.data.size());
+        if (inFlow <= 0) {
+            break;
+        }
+        bytesCopied += inFlow;
+        extractedSize.fetchAndAddRelaxed(inFlow);
+
+        if (inFlow != out.write(block.data.constData(), inFlow)) {
+            return { QFile::WriteError, tr("Failure to write block") };
+        }
+    }
+
+    if (bytesCopied != in.size()) {
+        return { QFile::ReadError, tr("Unable to read from the source") };
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::flushExtractedFile(QFile &out, qint64 size)
+{
+    // Strict durability waits for every file. Batched durability only starts writing large files back, so there is less
+    // left to do when syncExtractedFiles() waits for all of them
+    if (durability == StrictSync) {
+        Tracer::Scope syncScope(tracer, Tracer::Sync);
+        if (!FileSync::syncFile(out)) {
+            return { QFile::WriteError, tr("Unable to write the file to the disk: %1").arg(out.fileName()) };
+        }
+    } else if (durability == BatchedSync) {
+        FileSync::startWriteBack(out, size);
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::extractPayloadDuplicate(const Payload::Entry &entry, const QString &destination)
+{
+    const Payload::Entry &original = payload.entries().at(entry.original);
+    QString originalPath;
+    {
+        QMutexLocker locker(&manifestMutex);
+        int originalEntry = payloadManifestEntries.value(entry.original, -1);
+        if (originalEntry >= 0 && (manifest.testFlag(originalEntry, Manifest::Extracted) || manifest.testFlag(originalEntry, Manifest::Unchanged))) {
+            originalPath = getDestinationPath(originalEntry);
+        }
+    }
+
+    // An original that is not installed (e.g. its component was deselected) is extracted again, with this path and permissions
+    if (originalPath.isEmpty()) {
+        Payload::Entry contents = original;
+        contents.path = entry.path;
+        contents.permissions = entry.permissions;
+        return extractPayloadEntry(contents, destination);
+    }
+
+    // Hard links share the permissions of the original, clones and copies have their own
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    bool hardLinked = duplicateMode == HardLinkDuplicates && original.permissions == entry.permissions && FileLink::hardLink(originalPath, destination);
+    bool cloned = !hardLinked && duplicateMode != CopyDuplicates && FileLink::clone(originalPath, destination);
+    if (!hardLinked && !cloned) {
+        copyScope.stop();
+        QPair<QFile::FileError, QString> copyResult = extractSingleFile(originalPath, destination);
+        if (copyResult.first != QFile::NoError) {
+            return copyResult;
+        }
+    } else {
+        extractedSize.fetchAndAddRelaxed(entry.size);
+    }
+    copyScope.stop();
+
+    if (!hardLinked) {
+        Tracer::Scope permissionsScope(tracer, Tracer::SetPermissions);
+        if (!QFile::setPermissions(destination, entry.permissions)) {
+            return { QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, qt_error_string()) };
+        }
+    }
+    if (durability == StrictSync && (hardLinked || cloned)) {
+        Tracer::Scope syncScope(tracer, Tracer::Sync);
+        if (!FileSync::syncPath(destination)) {
+            return { QFile::WriteError, tr("Unable to write the file to the disk: %1").arg(destination) };
+        }
+    }
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::extractPayloadEntry(const Payload::Entry &entry, const QString &destination, QByteArray *packData, qint64 resumeOffset)
+{
+    if (entry.pack >= 0 && !packData) {
+        QByteArray data;
+        QPair<QFile::FileError, QString> packedResult = extractPackedEntry(entry, destination, &data);
+        if (!data.isNull()) {
+            bufferPool.release(&data);
+        }
+        return packedResult;
+    } else if (entry.pack >= 0) {
+        return extractPackedEntry(entry, destination, packData);
+    }
+
+    // A resumed file keeps the chunks written before the installation stopped
+    QFile out(destination);
+    if (resumeOffset == 0 && QFile::exists(destination)) {
+        return { QFile::CopyError, tr("Destination file exists: %1").arg(destination) };
+    }
+    Tracer::Scope openScope(tracer, Tracer::Open);
+    if (!out.open((resumeOffset > 0 ? QIODevice::ReadWrite : QIODevice::WriteOnly) | QIODevice::Unbuffered)) {
+        return { out.error(), out.errorString() };
+    }
+    if (resumeOffset > 0 && (!out.resize(resumeOffset) || !out.seek(resumeOffset))) {
+        out.close();
+        return { QFile::ResizeError, out.errorString() };
+    }
+    FileSync::preallocate(out, entry.size);
+    openScope.stop();
+
+    // Resumable installations record how much of a large file is written from time to time, and when they are suspended.
+    // Only chunks verified on their own can be continued, older payloads verify the whole file
+    bool continuable = checkpoint.isActive() && !updateMode && payload.hasChunkChecksums() && entry.chunks.size() > 1;
+    qint64 writtenSize = resumeOffset;
+    QElapsedTimer partialRecordClock;
+    partialRecordClock.start();
+
+    // Chunks of large entries are decompressed by the decompression pool while this thread writes them in order
+    QQueue<QFuture<QPair<QByteArray, QString>>> chunksInFlight;
+
+    auto failure = [&](QFile::FileError error, const QString &errorString) -> QPair<QFile::FileError, QString> {
+        // Decompressions still running read from the payload, so wait for them before leaving
+        while (!chunksInFlight.isEmpty()) {
+            QPair<QByteArray, QString> decompressedChunk = chunksInFlight.dequeue().result();
+            bufferPool.release(&decompressedChunk.first);
+        }
+        bool suspended = error == QFile::AbortError && suspendRequested.loadAcquire();
+        if (suspended && continuable && writtenSize > 0 && checkpoint.recordPartialFile(out, entry.path, writtenSize)) {
+            out.close();
+            return { error, errorString };
+        }
+        out.close();
+        out.remove();
+        return { error, errorString };
+    };
+
+    auto decompressChunk = [this](const Payload::Chunk &chunk) {
+        QPair<QByteArray, QString> decompressedChunk;
+        decompressedChunk.first = takeChunkBuffer(chunk);
+        if (!payload.readChunk(chunk, &decompressedChunk.first, &decompressedChunk.second) && decompressedChunk.second.isNull()) {
+            decompressedChunk.second = tr("Unable to read from the payload");
+        }
+        return decompressedChunk;
+    };
+
+    // Chunks are verified by the payload as they are decompressed. Older payloads only have the checksum of the whole entry
+    bool verifyEntry = !payload.hasChunkChecksums();
+    Checksum checksum;
+
+    auto writeChunk = [&](const QPair<QByteArray, QString> &decompressedChunk) -> QPair<QFile::FileError, QString> {
+        if (!decompressedChunk.second.isNull()) {
+            return { QFile::ReadError, decompressedChunk.second };
+        }
+        if (verifyEntry) {
+            checksum.addData(decompressedChunk.first.constData(), decompressedChunk.first.size());
+        }
+        if (decompressedChunk.first.size() != out.write(decompressedChunk.first)) {
+            return { QFile::WriteError, tr("Failure to write block") };
+        }
+        extractedSize.fetchAndAddRelaxed(decompressedChunk.first.size());
+        writtenSize += decompressedChunk.first.size();
+        if (continuable && partialRecordClock.hasExpired(Checkpoint::interval)) {
+            partialRecordClock.restart();
+            if (!checkpoint.recordPartialFile(out, entry.path, writtenSize)) {
+                return { QFile::WriteError, checkpoint.errorString() };
+            }
+        }
+        return { QFile::NoError, QString() };
+    };
+
+    auto writeOldestChunk = [&]() {
+        QPair<QByteArray, QString> decompressedChunk = chunksInFlight.dequeue().result();
+        QPair<QFile::FileError, QString> writeResult = writeChunk(decompressedChunk);
+        bufferPool.release(&decompressedChunk.first);
+        return writeResult;
+    };
+
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    qint64 skippedSize = 0;
+    for (auto chunk : entry.chunks) {
+        if (skippedSize < resumeOffset) { // written before the installation stopped
+            skippedSize += chunk.size;
+            continue;
+        }
+        if (!cancellation.checkpoint()) {
+            return failure(QFile::AbortError, tr("Operation canceled"));
+        }
+
+        if (entry.chunks.size() == 1) { // nothing to overlap with
+            bufferPool.reserve();
+            QPair<QByteArray, QString> decompressedChunk = decompressChunk(chunk);
+            QPair<QFile::FileError, QString> writeResult = writeChunk(decompressedChunk);
+            bufferPool.release(&decompressedChunk.first);
+            if (writeResult.first != QFile::NoError) {
+                return failure(writeResult.first, writeResult.second);
+            }
+            continue;
+        }
+
+        // The buffer pool bounds the memory used by all the entries being extracted. Without a free buffer, write the oldest chunk
+        // first, so decompression never runs ahead of the writes
+        while (!bufferPool.tryReserve()) {
+            if (chunksInFlight.isEmpty()) {
+                bufferPool.reserve(); // other entries are writing theirs
+                break;
+            }
+            QPair<QFile::FileError, QString> writeResult = writeOldestChunk();
+            if (writeResult.first != QFile::NoError) {
+                return failure(writeResult.first, writeResult.second);
+            }
+        }
+        chunksInFlight.enqueue(QtConcurrent::run(&decompressionPool, [decompressChunk, chunk]() {
+            return decompressChunk(chunk);
+        }));
+
+        // Write every chunk that is ready, without waiting for the others
+        while (!chunksInFlight.isEmpty() && chunksInFlight.head().isFinished()) {
+            QPair<QFile::FileError, QString> writeResult = writeOldestChunk();
+            if (writeResult.first != QFile::NoError) {
+                return failure(writeResult.first, writeResult.second);
+            }
+        }
+    }
+
+    while (!chunksInFlight.isEmpty()) {
+        QPair<QFile::FileError, QString> writeResult = writeOldestChunk();
+        if (writeResult.first != QFile::NoError) {
+            return failure(writeResult.first, writeResult.second);
+        }
+    }
+    if (verifyEntry && checksum.result() != entry.checksum) {
+        return failure(QFile::ReadError, tr("Corrupted file in the payload: %1").arg(entry.path));
+    }
+    copyScope.stop();
+
+    Tracer::Scope permissionsScope(tracer, Tracer::SetPermissions);
+    if (!out.setPermissions(entry.permissions)) {
+        return failure(QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, out.errorString()));
+    }
+    permissionsScope.stop();
+    QPair<QFile::FileError, QString> flushResult = flushExtractedFile(out, entry.size);
+    if (flushResult.first != QFile::NoError) {
+        out.close();
+        out.remove();
+        return flushResult;
+    }
+    out.close();
+    return { QFile::NoError, QString() };
+}
+
+QByteArray Installer::takeChunkBuffer(const Payload::Chunk &chunk)
+{
+    // Stored chunks are read into a buffer of the pool. Chunks of memory-mapped payloads are not copied, and compressed ones
+    // are replaced by the output of zlib, so a buffer would be allocated for nothing
+    if (chunk.compressionMethod == Payload::Stored && !payload.isMapped()) {
+        return bufferPool.takeBuffer();
+    }
+    return QByteArray();
+}
+
+QPair<QFile::FileError, QString> Installer::extractPackedEntry(const Payload::Entry &entry, const QString &destination, QByteArray *packData)
+{
+    QFile out(destination);
+    if (QFile::exists(destination)) {
+        return { QFile::CopyError, tr("Destination file exists: %1").arg(destination) };
+    }
+
+    // The pack is decompressed and verified by the first of its files that is extracted, the rest reuse it.
+    // Its buffer is given back to the pool by the caller
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    if (packData->isNull()) {
+        QString errorString;
+        bufferPool.reserve();
+        *packData = takeChunkBuffer(payload.packs().at(entry.pack));
+        if (!payload.readChunk(payload.packs().at(entry.pack), packData, &errorString)) {
+            bufferPool.release(packData);
+            return { QFile::ReadError, errorString.isNull() ? tr("Unable to read from the payload") : errorString };
+        }
+    }
+    copyScope.stop();
+
+    Tracer::Scope openScope(tracer, Tracer::Open);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        return { out.error(), out.errorString() };
+    }
+    openScope.stop();
+
+    Tracer::Scope writeScope(tracer, Tracer::Copy);
+    if (out.write(packData->constData() + entry.packOffset, entry.size) != entry.size) {
+        out.close();
+        out.remove();
+        return { QFile::WriteError, tr("Failure to write block") };
+    }
+    extractedSize.fetchAndAddRelaxed(entry.size);
+    writeScope.stop();
+
+    Tracer::Scope permissionsScope(tracer, Tracer::SetPermissions);
+    if (!out.setPermissions(entry.permissions)) {
+        QPair<QFile::FileError, QString> permissionsResult = { QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, out.errorString()) };
+        out.close();
+        out.remove();
+        return permissionsResult;
+    }
+    permissionsScope.stop();
+    QPair<QFile::FileError, QString> flushResult = flushExtractedFile(out, entry.size);
+    if (flushResult.first != QFile::NoError) {
+        out.close();
+        out.remove();
+        return flushResult;
+    }
+    out.close();
+    return { QFile::NoError, QString() };
+}
+
+QPair<QFile::FileError, QString> Installer::extractPayloadDelta(const Payload::Entry &entry, const QString &installedPath, const QString &destination)
+{
+    // The new version is written next to the installed one, and moved over it once the update is complete
+    QFile base(installedPath);
+    if (!updateMode || !base.exists() || base.size() != entry.baseSize || destination == installedPath) {
+        return { QFile::OpenError, tr("The previous version of the file is required to update it: %1").arg(installedPath) };
+    }
+    Tracer::Scope openScope(tracer, Tracer::Open);
+    if (!base.open(QIODevice::ReadOnly)) {
+        return { base.error(), base.errorString() };
+    }
+    QFile out(destination);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        return { out.error(), out.errorString() };
+    }
+    FileSync::preallocate(out, entry.size);
+    openScope.stop();
+
+    auto failure = [&](QFile::FileError error, const QString &errorString) -> QPair<QFile::FileError, QString> {
+        out.close();
+        out.remove();
+        return { error, errorString };
+    };
+
+    // The new version is verified as it is written, the installed file is only replaced if it matches. Cancellation is
+    // checked for every piece written, as a single copy instruction may rebuild gigabytes
+    Checksum checksum;
+    bool canceled = false;
+    DeltaPatcher patcher(base, [&](const char *data, qint64 size) {
+        if (!cancellation.checkpoint()) {
+            canceled = true;
+            return false;
+        }
+        if (out.write(data, size) != size) {
+            return false;
+        }
+        checksum.addData(data, size);
+        extractedSize.fetchAndAddRelaxed(size);
+        return true;
+    });
+    Tracer::Scope copyScope(tracer, Tracer::Copy);
+    BufferPool::Lease data(bufferPool);
+    for (auto chunk : entry.chunks) {
+        if (!cancellation.checkpoint()) {
+            return failure(QFile::AbortError, tr("Operation canceled"));
+        }
+        QString errorString;
+        if (!payload.readChunk(chunk, &data.data, &errorString)) {
+            return failure(QFile::ReadError, errorString.isNull() ? tr("Unable to read from the payload") : errorString);
+        }
+        if (!patcher.addData(data.data.constData(), data.data.size())) {
+            if (canceled) {
+                return failure(QFile::AbortError, tr("Operation canceled"));
+            }
+            return failure(out.error() != QFile::NoError ? out.error() : QFile::ReadError, patcher.errorString());
+        }
+    }
+    if (!patcher.finish()) {
+        return failure(QFile::ReadError, patcher.errorString());
+    }
+    if (patcher.writtenSize() != entry.size || checksum.result() != entry.checksum) {
+        return failure(QFile::ReadError, tr("The updated file does not match the payload: %1").arg(installedPath));
+    }
+    copyScope.stop();
+
+    Tracer::Scope permissionsScope(tracer, Tracer::SetPermissions);
+    if (!out.setPermissions(entry.permissions)) {
+        return failure(QFile::PermissionsError, tr("Unable to set the permissions of the file %1: %2").arg(destination, out.errorString()));
+    }
+    permissionsScope.stop();
+    QPair<QFile::FileError, QString> flushResult = flushExtractedFile(out, entry.size);
+    if (flushResult.first != QFile::NoError) {
+        return failure(flushResult.first, flushResult.second);
+    }
+    out.close();
+    base.close();
+    return { QFile::NoError, QString() };
+}
+
+void Installer::revertInstallation()
+{
+    // Updates only revert what they wrote. Unchanged files stay, and replaced files keep their previous versions, which
+    // are only replaced once the update is complete
+    if (updateMode) {
+        for (int entry = 0; entry < manifest.entryCount(); entry++) {
+            if (manifest.testFlag(entry, Manifest::Unchanged)) {
+                manifest.setFlag(entry, Manifest::Extracted, false);
+                extractedSize.fetchAndAddRelaxed(-manifest.entrySize(entry));
+                extractedFileCount.fetchAndAddRelaxed(-1);
+            }
+        }
+    }
+    sizeToRevert = extractedSize.loadAcquire();
+    setInstallerStatus(RevertingInstallation);
+
+    bool reverted = removeIntegrationEntries();
+    if (!checkpoint.remove()) { // nothing is left to resume
+        qWarning("Unable to remove the installation checkpoint: %s", qPrintable(checkpoint.errorString()));
+    }
+
+    // The staging directory goes away as a whole, and so do the journaled files of an update
+    if (journal.isActive()) {
+        Tracer::Scope rollbackScope(tracer, Tracer::Rollback, Journal::stagingPath(installationPath));
+        if (!journal.rollback()) {
+            emit reversionFailed();
+            return;
+        }
+        extractedSize.storeRelease(0);
+        extractedFileCount.storeRelease(0);
+    } else {
+        reverted = removeExtractedFiles() && reverted;
+    }
+    if (!reverted) {
+        emit reversionFailed();
+    }
+}
+
+bool Installer::removeIntegrationEntries()
+{
+    QMutexLocker locker(&integrationMutex);
+    bool removed = true;
+    for (auto filePath : integrationEntries) {
+        if (QFile::exists(filePath) && !QFile::remove(filePath)) {
+            qWarning("Cannot remove '%s'", qPrintable(filePath));
+            removed = false;
+        }
+    }
+    integrationEntries.clear();
+    if (controlPanelEntryAdded) {
+        QSettings sUnins(QSettings::UserScope, QDir::toNativeSeparators("Microsoft/Windows/CurrentVersion/Uninstall"), QCoreApplication::applicationName());
+        sUnins.clear();
+        controlPanelEntryAdded = false;
+    }
+    return removed;
+}
+
+bool Installer::removeExtractedFiles()
+{
+    // Paths are taken from the manifest up front, it is not thread-safe
+    QVector<int> entries;
+    QStringList filePaths;
+    QSet<int> directories;
+    for (int entry = 0; entry < manifest.entryCount(); entry++) {
+        if (manifest.testFlag(entry, Manifest::Extracted)) {
+            entries << entry;
+            filePaths << getDestinationPath(entry);
+            if (!manifest.testFlag(entry, Manifest::Additional)) {
+                directories.insert(manifest.entryDirectory(entry));
+            }
+        }
+    }
+
+    // Every worker removes the next file until there are no more. A file that can't be removed does not stop the others
+    QVector<quint8> removed(entries.size(), 0);
+    quint8 *removedFiles = removed.data(); // every worker writes its own files
+    QAtomicInt nextFile = 0;
+    auto worker = [&]() {
+        forever {
+            int file = nextFile.fetchAndAddRelaxed(1);
+            if (file >= entries.size()) {
+                return;
+            }
+            Tracer::FileScope fileScope(tracer, filePaths.at(file));
+            Tracer::Scope rollbackScope(tracer, Tracer::Rollback);
+            if (QFile::remove(filePaths.at(file)) || !QFile::exists(filePaths.at(file))) {
+                removedFiles[file] = 1;
+                extractedSize.fetchAndAddRelaxed(-manifest.entrySize(entries.at(file)));
+                components.addProcessedSize(entryComponents.value(entries.at(file), -1), -manifest.entrySize(entries.at(file)));
+                extractedFileCount.fetchAndAddRelaxed(-1);
+            }
+        }
+    };
+    int workerCount = qBound(1, maxConcurrentExtractions, entries.size());
+    QList<QFuture<void>> workers;
+    for (int i = 1; i < workerCount; i++) {
+        workers << QtConcurrent::run(&extractionPool, worker);
+    }
+    worker(); // the current thread is a worker too
+    for (auto future : workers) {
+        future.waitForFinished();
+    }
+
+    bool reverted = true;
+    for (int file = 0; file < entries.size(); file++) {
+        if (removed.at(file)) {
+            manifest.setFlag(entries.at(file), Manifest::Extracted, false);
+        } else {
+            qWarning("Cannot remove '%s'", qPrintable(filePaths.at(file)));
+            reverted = false;
+        }
+    }
+
+    // Directories are removed once each, deepest first, and only if they are empty: rmdir() fails otherwise, without listing them
+    QSet<QString> directoryPaths;
+    for (int directory : directories) {
+        QString path = manifest.directoryPath(directory);
+        while (!path.isEmpty() && !directoryPaths.contains(path)) {
+            directoryPaths.insert(path);
+            path = path.left(qMax(0, path.lastIndexOf('/')));
+        }
+    }
+    QStringList sortedDirectoryPaths = directoryPaths.values();
+    std::sort(sortedDirectoryPaths.begin(), sortedDirectoryPaths.end(), [](const QString &a, const QString &b) {
+        return a.count('/') > b.count('/');
+    });
+    // Updates only remove the directories they created, the ones already installed stay even if they are empty now
+    QDir root(extractionRoot);
+    Tracer::Scope rollbackScope(tracer, Tracer::Rollback, extractionRoot);
+    for (auto path : sortedDirectoryPaths) {
+        if (!updateMode || directoryCache.wasCreated(extractionRoot + path)) {
+            root.rmdir(path);
+        }
+    }
+
+    // A new installation path must be left as it was found. Anything else in it was put there during the installation
+    if (!updateMode && root.exists() && !root.rmdir(root.path())) {
+        root.removeRecursively();
+    }
+    return reverted;
+}
+
+//! Access descriptors
+
+QString Installer::getDataPath() const
+{
+    return dataPath;
+}
+
+void Installer::setDataPath(const QString &value)
+{
+    dataPath = value;
+}
+
+QString Installer::getPayloadPath() const
+{
+    return payloadPath;
+}
+
+void Installer::setPayloadPath(const QString &value)
+{
+    payloadPath = value;
+}
+
+QString Installer::getInstallationPath() const
+{
+    return installationPath;
+}
+
+void Installer::setInstallationPath(const QString &value)
+{
+    if (installationPath != value) {
+        installationPath = value;
+        validateInstallationPath();
+        emit installationPathChanged(value);
+    }
+}
+
+bool Installer::getInstallationPathIsValid() const
+{
+    return installationPathIsValid;
+}
+
+void Installer::setInstallationPathIsValid(bool value) // private
+{
+    if (installationPathIsValid != value) {
+        installationPathIsValid = value;
+        emit installationPathIsValidChanged(value);
+    }
+}
+
+Installer::InstallationPathError Installer::getInstallationPathError() const
+{
+    return installationPathError;
+}
+
+void Installer::setInstallationPathError(const InstallationPathError &value) // private
+{
+    if (installationPathError != value) {
+        installationPathError = value;
+        setInstallationPathErrorString(installationPathErrorMap[value]);
+        emit installationPathErrorChanged(value);
+    }
+}
+
+QString Installer::getInstallationPathErrorString() const
+{
+    return installationPathErrorString;
+}
+
+void Installer::setInstallationPathErrorString(const QString &value) // private
+{
+    if (installationPathErrorString != value) {
+        installationPathErrorString = value;
+        emit installationPathErrorStringChanged(value);
+    }
+}
+
+qint64 Installer::getTotalSize() const
+{
+    return totalSize;
+}
+
+void Installer::setTotalSize(const qint64 &value) // private
+{
+    if (totalSize != value) {
+        totalSize = value;
+        emit totalSizeChanged(value);
+    }
+}
+
+bool Installer::getTransactional() const
+{
+    return transactional;
+}
+
+void Installer::setTransactional(bool value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The transactional mode can only be changed in IDLE installer status");
+        return;
+    }
+    if (transactional != value) {
+        transactional = value;
+        emit transactionalChanged(value);
+        validateInstallationPath();
+    }
+}
+
+bool Installer::getUpdateMode() const
+{
+    return updateMode;
+}
+
+void Installer::setUpdateMode(bool value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The update mode can only be changed in IDLE installer status");
+        return;
+    }
+    if (updateMode != value) {
+        updateMode = value;
+        emit updateModeChanged(value);
+        validateInstallationPath();
+    }
+}
+
+bool Installer::getResumable() const
+{
+    return resumable;
+}
+
+void Installer::setResumable(bool value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The resumable mode can only be changed in IDLE installer status");
+        return;
+    }
+    if (resumable != value) {
+        resumable = value;
+        emit resumableChanged(value);
+        validateInstallationPath();
+    }
+}
+
+Installer::Durability Installer::getDurability() const
+{
+    return durability;
+}
+
+void Installer::setDurability(Durability value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The durability can only be changed in IDLE installer status");
+        return;
+    }
+    if (durability != value) {
+        durability = value;
+        emit durabilityChanged(value);
+    }
+}
+
+Installer::IoBackend Installer::getIoBackend() const
+{
+    return ioBackend;
+}
+
+void Installer::setIoBackend(IoBackend value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The I/O backend can only be changed in IDLE installer status");
+        return;
+    }
+    if (ioBackend != value) {
+        ioBackend = value;
+        emit ioBackendChanged(value);
+    }
+}
+
+Installer::DuplicateMode Installer::getDuplicateMode() const
+{
+    return duplicateMode;
+}
+
+void Installer::setDuplicateMode(DuplicateMode value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The duplicate mode can only be changed in IDLE installer status");
+        return;
+    }
+    if (duplicateMode != value) {
+        duplicateMode = value;
+        emit duplicateModeChanged(value);
+    }
+}
+
+bool Installer::getTracingEnabled() const
+{
+    return tracingEnabled;
+}
+
+void Installer::setTracingEnabled(bool value)
+{
+    if (installerStatus != Idle) {
+        qCritical("Tracing can only be changed in IDLE installer status");
+        return;
+    }
+    if (tracingEnabled != value) {
+        tracingEnabled = value;
+        emit tracingEnabledChanged(value);
+    }
+}
+
+int Installer::getTraceSamplingInterval() const
+{
+    return traceSamplingInterval;
+}
+
+void Installer::setTraceSamplingInterval(int value)
+{
+    if (value < 1) {
+        qWarning("The trace sampling interval must be at least 1. Default to 1");
+        value = 1;
+    }
+    if (traceSamplingInterval != value) {
+        traceSamplingInterval = value;
+        emit traceSamplingIntervalChanged(value);
+    }
+}
+
+QVariantMap Installer::getTraceSummary() const
+{
+    return tracer.summary();
+}
+
+QVariantList Installer::getComponents() const
+{
+    QVariantList componentList;
+    for (int component = 0; component < components.count(); component++) {
+        const ComponentSet::Component &definition = components.at(component);
+        qint64 size = components.size(component);
+        qint64 processedSize = components.processedSize(component);
+        QVariantMap componentMap;
+        componentMap["name"] = definition.name;
+        componentMap["path"] = definition.path;
+        componentMap["dependencies"] = definition.dependencies;
+        componentMap["optional"] = definition.optional;
+        componentMap["selected"] = definition.selected;
+        componentMap["state"] = ComponentSet::stateName(components.state(component));
+        componentMap["size"] = size;
+        componentMap["extractedSize"] = processedSize;
+        componentMap["progress"] = size > 0 ? double(processedSize) / size : 0;
+        componentList.append(componentMap);
+    }
+    return componentList;
+}
+
+int Installer::getMaxConcurrentExtractions() const
+{
+    return maxConcurrentExtractions;
+}
+
+void Installer::setMaxConcurrentExtractions(int value)
+{
+    if (value < 1) {
+        qWarning("At least one concurrent extraction is required. Default to 1");
+        value = 1;
+    }
+    if (maxConcurrentExtractions != value) {
+        maxConcurrentExtractions = value;
+        extractionPool.setMaxThreadCount(qMax(1, value - 1)); // the extracting thread itself is also a worker
+        emit maxConcurrentExtractionsChanged(value);
+    }
+}
+
+qint64 Installer::getMemoryLimit() const
+{
+    return memoryLimit;
+}
+
+void Installer::setMemoryLimit(qint64 value)
+{
+    if (installerStatus != Idle) {
+        qCritical("The memory limit can only be changed in IDLE installer status");
+        return;
+    }
+    if (value < minMemoryLimit) {
+        qWarning("The memory limit must be at least %lld bytes. Default to %lld bytes", minMemoryLimit, minMemoryLimit);
+        value = minMemoryLimit;
+    }
+    if (memoryLimit != value) {
+        memoryLimit = value;
+        emit memoryLimitChanged(value);
+    }
+}
+
+double Installer::getProgress() const
+{
+    switch (installerStatus) {
+    case ExtractingPackages:
+        return totalSize > 0 ? double(extractedSize.loadAcquire()) / totalSize : 0;
+    case RevertingInstallation:
+        return sizeToRevert > 0 ? 1 - double(extractedSize.loadAcquire()) / sizeToRevert : 0;
+    case ExtractionFinished:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int Installer::getExtractedFileCount() const
+{
+    return extractedFileCount.loadAcquire();
+}
+
+int Installer::getTotalFileCount() const
+{
+    return totalFileCount;
+}
+
+void Installer::setTotalFileCount(int value) // private
+{
+    if (totalFileCount != value) {
+        totalFileCount = value;
+        emit totalFileCountChanged(value);
+    }
+}
+
+double Installer::getThroughput() const
+{
+    return throughput;
+}
+
+qint64 Installer::getRemainingTime() const
+{
+    return remainingTime;
+}
+
+int Installer::getProgressInterval() const
+{
+    return progressInterval;
+}
+
+void Installer::setProgressInterval(int value)
+{
+    value = qMax(0, value);
+    if (progressInterval != value) {
+        progressInterval = value;
+        if (value == 0) {
+            progressTimer.stop();
+        } else if (progressTimer.isActive()) {
+            progressTimer.setInterval(value);
+        }
+        emit progressIntervalChanged(value);
+    }
+}
+
+QOperatingSystemVersion::OSType Installer::getCurrentOS()
+{
+    return currentOS;
+}
+
+Installer::InstallerStatus Installer::getInstallerStatus() const
+{
+    return installerStatus;
+}
+
+bool Installer::getPaused() const
+{
+    return cancellation.isPaused();
 }
 
 void Installer::setInstallerStatus(const InstallerStatus &value) // private
@@ -14,13 +14,42 @@
 #include <QFileInfo>
 #include <QFile>
 #include <QDir>
+#include <QDirIterator>
 #include <QSysInfo>
 #include <QCoreApplication>
 #include <QtConcurrent/QtConcurrent>
 #include <QFuture>
-#include <QFutureWatcher>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QSemaphore>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QtMath>
+#include <QAtomicInteger>
 #include <QOperatingSystemVersion>
 #include <QStandardPaths>
+#include <QResource>
+#include <QSaveFile>
+#include <QSet>
+#include <functional>
+
+#include "bufferpool.h"
+#include "cancellationtoken.h"
+#include "checkpoint.h"
+#include "checksum.h"
+#include "componentset.h"
+#include "delta.h"
+#include "directorycache.h"
+#include "filelink.h"
+#include "filesync.h"
+#include "iouring.h"
+#include "journal.h"
+#include "manifest.h"
+#include "payload.h"
+#include "tracer.h"
 
 class Installer : public QObject
 {
@@ -32,7 +61,26 @@ class Installer : public QObject
     Q_PROPERTY(QString installationPathErrorString READ getInstallationPathErrorString NOTIFY installationPathErrorStringChanged)
 
     Q_PROPERTY(InstallerStatus installerStatus READ getInstallerStatus NOTIFY installerStatusChanged)
+    Q_PROPERTY(bool paused READ getPaused NOTIFY pausedChanged)
     Q_PROPERTY(quint64 totalSize READ getTotalSize NOTIFY totalSizeChanged)
+    Q_PROPERTY(int totalFileCount READ getTotalFileCount NOTIFY totalFileCountChanged)
+    Q_PROPERTY(double progress READ getProgress NOTIFY progressChanged)
+    Q_PROPERTY(int extractedFileCount READ getExtractedFileCount NOTIFY progressChanged)
+    Q_PROPERTY(double throughput READ getThroughput NOTIFY progressChanged)
+    Q_PROPERTY(qint64 remainingTime READ getRemainingTime NOTIFY progressChanged)
+    Q_PROPERTY(int progressInterval READ getProgressInterval WRITE setProgressInterval NOTIFY progressIntervalChanged)
+    Q_PROPERTY(int maxConcurrentExtractions READ getMaxConcurrentExtractions WRITE setMaxConcurrentExtractions NOTIFY maxConcurrentExtractionsChanged)
+    Q_PROPERTY(qint64 memoryLimit READ getMemoryLimit WRITE setMemoryLimit NOTIFY memoryLimitChanged)
+    Q_PROPERTY(bool transactional READ getTransactional WRITE setTransactional NOTIFY transactionalChanged)
+    Q_PROPERTY(bool updateMode READ getUpdateMode WRITE setUpdateMode NOTIFY updateModeChanged)
+    Q_PROPERTY(bool resumable READ getResumable WRITE setResumable NOTIFY resumableChanged)
+    Q_PROPERTY(IoBackend ioBackend READ getIoBackend WRITE setIoBackend NOTIFY ioBackendChanged)
+    Q_PROPERTY(DuplicateMode duplicateMode READ getDuplicateMode WRITE setDuplicateMode NOTIFY duplicateModeChanged)
+    Q_PROPERTY(Durability durability READ getDurability WRITE setDurability NOTIFY durabilityChanged)
+    Q_PROPERTY(bool tracingEnabled READ getTracingEnabled WRITE setTracingEnabled NOTIFY tracingEnabledChanged)
+    Q_PROPERTY(int traceSamplingInterval READ getTraceSamplingInterval WRITE setTraceSamplingInterval NOTIFY traceSamplingIntervalChanged)
+    Q_PROPERTY(QVariantMap traceSummary READ getTraceSummary NOTIFY progressChanged)
+    Q_PROPERTY(QVariantList components READ getComponents NOTIFY progressChanged)
 
     Q_PROPERTY(QOperatingSystemVersion::OSType currentOS READ getCurrentOS CONSTANT)
 
@@ -40,14 +88,26 @@ public:
     enum InstallationPathError { NoPathError, PathNotSpecified, PathIsAFile, PathIsNotAbsolute, PathIsNotEmpty };
     Q_ENUM(InstallationPathError)
 
-    enum InstallerStatus { Idle, FetchingFiles, ExtractingPackages, ExtractionFinished, ExtractionCanceled, RevertingInstallation, ErrorOccurred };
+    enum InstallerStatus { Idle, FetchingFiles, ExtractingPackages, ExtractionFinished, ExtractionCanceled, RevertingInstallation, ErrorOccurred, ExtractionSuspended };
     Q_ENUM(InstallerStatus)
 
+    enum IoBackend { QFileBackend, IoUringBackend };
+    Q_ENUM(IoBackend)
+
+    enum Durability { NoSync, BatchedSync, StrictSync };
+    Q_ENUM(Durability)
+
+    enum DuplicateMode { CopyDuplicates, CloneDuplicates, HardLinkDuplicates };
+    Q_ENUM(DuplicateMode)
+
     explicit Installer(QObject *parent = nullptr);
 
     QString getDataPath() const;
     void setDataPath(const QString &value);
 
+    QString getPayloadPath() const;
+    void setPayloadPath(const QString &value);
+
     QString getInstallationPath() const;
     void setInstallationPath(const QString &value);
 
@@ -59,15 +119,73 @@ public:
 
     InstallerStatus getInstallerStatus() const;
 
+    bool getPaused() const;
+
     qint64 getTotalSize() const;
 
+    int getTotalFileCount() const;
+    double getProgress() const;
+    int getExtractedFileCount() const;
+    double getThroughput() const;
+    qint64 getRemainingTime() const;
+
+    int getProgressInterval() const;
+    void setProgressInterval(int value);
+
+    int getMaxConcurrentExtractions() const;
+    void setMaxConcurrentExtractions(int value);
+
+    qint64 getMemoryLimit() const;
+    void setMemoryLimit(qint64 value);
+
+    bool getTransactional() const;
+    void setTransactional(bool value);
+
+    bool getUpdateMode() const;
+    void setUpdateMode(bool value);
+
+    bool getResumable() const;
+    void setResumable(bool value);
+
+    IoBackend getIoBackend() const;
+    void setIoBackend(IoBackend value);
+
+    DuplicateMode getDuplicateMode() const;
+    void setDuplicateMode(DuplicateMode value);
+
+    Durability getDurability() const;
+    void setDurability(Durability value);
+
+    bool getTracingEnabled() const;
+    void setTracingEnabled(bool value);
+
+    int getTraceSamplingInterval() const;
+    void setTraceSamplingInterval(int value);
+
+    QVariantMap getTraceSummary() const;
+
+    QVariantList getComponents() const;
+
     QOperatingSystemVersion::OSType getCurrentOS();
 
+    // Same as extractAll() and verifyInstallation(), for C++ callers that wait for (or chain) the result
+    QFuture<bool> extractAllAsync();
+    QFuture<QStringList> verifyInstallationAsync();
+
 public slots:
     bool addFileToExtract(const QString &from, const QString &to);
+    bool addComponent(const QString &name, const QString &path, const QStringList &dependencies = QStringList(), bool optional = false);
+    bool setComponentSelected(const QString &name, bool selected);
     void extractAll();
+    bool extractAllAndWait();
+    QStringList verifyInstallation();
     void requestProgress();
     void cancel();
+    void pause();
+    void resume();
+    void suspend();
+    bool recoverInstallation();
+    bool exportTrace(const QString &filePath);
     bool addDesktopShortcut(const QString &linkName = QCoreApplication::applicationName(), const QString &executableEntryFilePath = QString());
     bool addWindowsStartMenuEntry(const QString &linkName = QCoreApplication::applicationName(), const QString &filePath = QString());
     bool addDesktopEntry(const QString &name = QCoreApplication::applicationName());
@@ -79,12 +197,29 @@ signals:
     void installationPathErrorChanged(InstallationPathError value);
     void installationPathErrorStringChanged(const QString &value);
     void installerStatusChanged(InstallerStatus value);
+    void pausedChanged(bool value);
     void totalSizeChanged(qint64 value);
+    void totalFileCountChanged(int value);
+    void progressChanged();
+    void progressIntervalChanged(int value);
+    void maxConcurrentExtractionsChanged(int value);
+    void memoryLimitChanged(qint64 value);
+    void transactionalChanged(bool value);
+    void updateModeChanged(bool value);
+    void resumableChanged(bool value);
+    void ioBackendChanged(IoBackend value);
+    void duplicateModeChanged(DuplicateMode value);
+    void durabilityChanged(Durability value);
+    void tracingEnabledChanged(bool value);
+    void traceSamplingIntervalChanged(int value);
 
     void fetchingStarted();
     void extractionStarted();
     void progressReported(double progress);
     void extractionFinished();
+    void extractionSuspended(); // the installation stopped, and can be resumed by the next extraction
+    void componentStarted(const QString &name);
+    void componentFinished(const QString &name);
     void reversionFinished(); // success on revert installation
 
     // Error handling
@@ -93,6 +228,7 @@ signals:
 
 private:
     QString dataPath; // stored in resources, not expose to QML
+    QString payloadPath; // stored in resources, not expose to QML. Used instead of dataPath if it exists
     QString desktopEntriesPath; // stored in resources, not expose to QML
 
     QString installationPath; // expose to QML
@@ -114,16 +250,58 @@ private:
     QString unix_baseInstallDir = QStandardPaths::standardLocations(QStandardPaths::HomeLocation).first() + "/Applications";
 
     InstallerStatus installerStatus = Idle; // expose as "read only" to QML
-    qint64 extractedSize = 0; // not expose to QML, check progress every some interval using a Timer that calls requestProgress()
+    QAtomicInteger<qint64> extractedSize = 0; // not expose to QML, check progress every some interval using a Timer that calls requestProgress()
     qint64 totalSize = 0; // expose as "read only" to QML
-    QFileInfoList filesToExtract; // not expose to QML
+    QAtomicInt extractedFileCount = 0; // expose as "read only" to QML
+    int totalFileCount = 0; // expose as "read only" to QML
+    qint64 sizeToRevert = 0; // not expose to QML, extractedSize when the reversion started
+    double throughput = 0; // expose as "read only" to QML, in bytes per second
+    qint64 remainingTime = -1; // expose as "read only" to QML, in milliseconds
+    int progressInterval = 0; // expose to QML, in milliseconds. 0 means that progress is only reported by requestProgress()
+    QTimer progressTimer; // not expose to QML
+    QElapsedTimer progressClock; // not expose to QML, started on every status change
+    qint64 lastProgressSampleTime = 0; // not expose to QML
+    qint64 lastProgressSampleSize = 0; // not expose to QML
+    QAtomicInteger<qint64> discoveredSize = 0; // not expose to QML, published as totalSize
+    QAtomicInt discoveredFileCount = 0; // not expose to QML, published as totalFileCount
+    QString extractionRoot; // not expose to QML, installation or staging path ending with '/' when the extraction started
+    bool transactional = false; // expose to QML
+    Journal journal; // not expose to QML, used by transactional installations
+    bool updateMode = false; // expose to QML
+    bool resumable = false; // expose to QML
+    Checkpoint checkpoint; // not expose to QML, used by resumable installations
+    QAtomicInt suspendRequested = 0; // not expose to QML, the extraction is canceled but not reverted
+    IoBackend ioBackend = QFileBackend; // expose to QML
+    DuplicateMode duplicateMode = CloneDuplicates; // expose to QML
+    Durability durability = BatchedSync; // expose to QML
+    bool tracingEnabled = false; // expose to QML
+    int traceSamplingInterval = 100; // expose to QML, events of one out of every traceSamplingInterval files are kept
+    Tracer tracer; // not expose to QML, its summary is exposed as "read only" traceSummary
+    Manifest manifest; // not expose to QML, every file to extract, also used to handle canceling
+    DirectoryCache directoryCache; // not expose to QML, destination directories created by the current extraction
+    QMutex integrationMutex; // not expose to QML, guards the following members
+    QStringList integrationEntries; // not expose to QML, shortcuts and desktop entries removed if the installation is reverted
+    bool controlPanelEntryAdded = false; // not expose to QML
+    QMutex manifestMutex; // not expose to QML, guards the manifest and the following members
+    // The following members are used to extract files while they are still being found
+    QThreadPool discoveryPool; // not expose to QML, lists directories in parallel
+    QWaitCondition discoveryCondition; // not expose to QML
+    QQueue<int> discoveredEntries; // not expose to QML, entries of the manifest found but not extracted yet
+    int pendingDirectoryCount = 0; // not expose to QML
+    QPair<QFile::FileError, QString> discoveryError; // not expose to QML
+    QAtomicInt discoveryStopped = 0; // not expose to QML, set when an extraction worker fails, so no more directories are created
+    Payload payload; // not expose to QML
+    QVector<int> payloadManifestEntries; // not expose to QML, manifest entry of every payload entry, -1 if it is not installed
+    QThreadPool decompressionPool; // not expose to QML, decompresses the chunks of large payload entries
+    int maxConcurrentExtractions = QThread::idealThreadCount(); // expose to QML
+    qint64 memoryLimit = 64 * 1024 * 1024; // expose to QML, bytes of I/O buffers shared by every extraction thread
+    BufferPool bufferPool; // not expose to QML, chunks being read, decompressed or written and copy buffers
+    QThreadPool extractionPool; // not expose to QML, workers used by runExtractionWorkers()
     // The following members are used to handle canceling
-    QFileInfoList extractedFiles; // not expose to QML
-    bool extractionCanceled = false; // not expose to QML
+    CancellationToken cancellation; // not expose to QML, checked by every stage, also pauses them. Exposed as "read only" paused
     QList<QPair<QString, QString>> additionalFiles; // not expose to QML
-
-    QFutureWatcher<QPair<QFileInfoList, qint64>> watcherSeeking; // not expose to QML
-    QFutureWatcher<void> watcherExtracting; // not expose to QML
+    ComponentSet components; // expose as "read only" to QML, with their progress
+    QVector<int> entryComponents; // not expose to QML, component of every entry of the manifest, -1 for the base
 
     static const QOperatingSystemVersion::OSType currentOS = QOperatingSystemVersion::currentType(); // expose as "CONSTANT" to QML
 
@@ -135,15 +313,66 @@ private:
     void setInstallationPathErrorString(const QString &value);
     void setInstallerStatus(const InstallerStatus &value);
     void setTotalSize(const qint64 &value);
+    void setTotalFileCount(int value);
 
     // Installation
     void setupInitialInstallationPath();
     void validateInstallationPath();
     void setupExtractingProcess();
-    QPair<QFileInfoList, qint64> findFilesToExtract(const QString &path);
+    void setupProgressReporting();
+    void updateThroughput();
+    void publishDiscoveredTotals();
+    void prepareExtraction();
+    bool runExtraction();
+    bool extractInstallation();
+    QString checkpointSource() const;
+    void findFilesToExtract();
+    void findFilesInDirectory(const QString &relativePath);
+    bool takeDiscoveredEntry(int *entry);
+    bool readPayload();
+    bool isFileUpToDate(const QString &origin, const QString &destination, qint64 size, int payloadEntry);
+    bool removeObsoleteFiles();
+    bool syncExtractedFiles();
+    bool replaceInstalledFiles();
+    void removeReplacementFiles();
+    bool writeInstalledFilesList();
+    QString getOriginPath(int entry) const;
+    QString getDestinationPath(int entry) const;
+    QString getInstalledPath(int entry) const;
+    void setupBufferPool();
     bool extractFiles();
+    bool extractDiscoveredFiles();
+    bool extractComponents();
+    bool extractListedEntries(const QVector<int> &entries);
+    bool extractPayloadEntries(const QVector<int> &entriesToExtract);
+    QPair<QFileDevice::FileError, QString> makeEntryDirectories(const QVector<int> &entries);
+    void batchPayloadEntries(const QVector<int> &entriesToExtract, QVector<int> *batchEntries, QVector<int> *batchOffsets,
+                             QVector<int> *batchPacks, QVector<int> *duplicateEntries);
+    bool canUseIoUring();
+    QPair<QFileDevice::FileError, QString> extractBatch(const int *entries, int entryCount, int pack, bool useIoUring);
+    bool extractEntries(int firstEntry, int entryCount);
+    QPair<QFileDevice::FileError, QString> extractEntry(int entry, QByteArray *packData = nullptr);
+    QPair<QFileDevice::FileError, QString> journalFile(const QString &installedPath, const QString &destination, bool additional);
+    QPair<QFileDevice::FileError, QString> prepareUpdate(int entry, const QString &origin, const QString &destination, qint64 size, int payloadEntry, bool *upToDate);
+    QPair<QFileDevice::FileError, QString> prepareResume(int entry, const QString &destination, qint64 size, int payloadEntry, bool *complete, qint64 *resumeOffset);
+    QPair<QFileDevice::FileError, QString> prepareUpdateResume(int entry, const QString &path, const QString &destination, qint64 size, bool *complete);
+    QPair<QFileDevice::FileError, QString> extractPackWithIoUring(int pack, const int *packEntries, int entryCount, IoUring *ring);
+    bool runExtractionWorkers(int maxWorkerCount, const std::function<QPair<QFile::FileError, QString> (bool *)> &extractNext);
+    QPair<QFileDevice::FileError, QString> extractPayloadEntry(const Payload::Entry &entry, const QString &destination, QByteArray *packData = nullptr, qint64 resumeOffset = 0);
+    QPair<QFileDevice::FileError, QString> extractPayloadDuplicate(const Payload::Entry &entry, const QString &destination);
+    QByteArray takeChunkBuffer(const Payload::Chunk &chunk);
+    QPair<QFileDevice::FileError, QString> extractPackedEntry(const Payload::Entry &entry, const QString &destination, QByteArray *packData);
+    QPair<QFileDevice::FileError, QString> extractPayloadDelta(const Payload::Entry &entry, const QString &installedPath, const QString &destination);
     QPair<QFileDevice::FileError, QString> extractSingleFile(const QString &origin, const QString &destination);
+    QPair<QFileDevice::FileError, QString> copyFileContents(QFile &in, QFile &out);
+    QPair<QFileDevice::FileError, QString> copyFromMemory(const char *data, qint64 size, QFile &out);
+    QPair<QFileDevice::FileError, QString> copyWithKernel(QFile &in, QFile &out, bool *handled);
+    QPair<QFileDevice::FileError, QString> copyWithBuffer(QFile &in, QFile &out);
+    QPair<QFileDevice::FileError, QString> flushExtractedFile(QFile &out, qint64 size);
     void revertInstallation();
+    void addIntegrationEntry(const QString &filePath);
+    bool removeIntegrationEntries();
+    bool removeExtractedFiles();
 };
 
 Q_DECLARE_METATYPE(QFile::FileError)
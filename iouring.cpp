@@ -0,0 +1,350 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "iouring.h"
+
+#if defined(Q_OS_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// The opcodes are enumerators, the probe macro tells the headers of Linux 5.6 apart, which know opens and closes.
+// Older headers build the ring as invalid, and files are written with QFile
+#if defined(Q_OS_LINUX) && defined(IO_URING_OP_SUPPORTED)
+#define SIF_IO_URING
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef SIF_IO_URING
+struct IoUring::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+    void *sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void *cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+};
+
+namespace {
+const qint64 maxWriteSize = 1024 * 1024 * 1024; // 1 GiB, the length of an operation is 32 bits
+
+int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned argCount)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+}
+
+// Files are created with their final permissions, but the umask may clear some of them, which must then be set
+// again with fchmod(). umask() can only read the mask by changing it, so it is read from /proc instead (Linux 4.7)
+int processUmask()
+{
+    static const int mask = []() {
+        int value = -1;
+        FILE *status = fopen("/proc/self/status", "re");
+        if (status) {
+            char line[256];
+            while (fgets(line, sizeof(line), status)) {
+                unsigned parsed;
+                if (sscanf(line, "Umask: %o", &parsed) == 1) {
+                    value = int(parsed);
+                    break;
+                }
+            }
+            fclose(status);
+        }
+        return value;
+    }();
+    return mask;
+}
+
+// Queues an operation for every index accepted by `prepare`, keeping the ring full, and hands every result to `complete`
+template<typename Ring, typename Prepare, typename Complete>
+bool runOperations(Ring *ring, int count, Prepare prepare, Complete complete)
+{
+    int next = 0;
+    unsigned inFlight = 0;
+    while (next < count || inFlight > 0) {
+        unsigned tail = __atomic_load_n(ring->sqTail, __ATOMIC_RELAXED);
+        unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+        unsigned queued = tail - head; // not submitted yet, after an interrupted io_uring_enter()
+        while (next < count && inFlight + queued < ring->entries) {
+            unsigned index = tail & *ring->sqMask;
+            io_uring_sqe *sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            if (prepare(next, sqe)) {
+                sqe->user_data = quint64(next);
+                ring->sqArray[index] = index;
+                tail++;
+                queued++;
+            }
+            next++;
+        }
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+        if (queued == 0 && inFlight == 0) {
+            continue;
+        }
+
+        int submitted = ioUringEnter(ring->fd, queued, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+        unsigned consumed = queued - (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE));
+        inFlight += consumed;
+
+        unsigned cqHead = __atomic_load_n(ring->cqHead, __ATOMIC_RELAXED);
+        unsigned cqTail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        while (cqHead != cqTail) {
+            const io_uring_cqe &cqe = ring->cqes[cqHead & *ring->cqMask];
+            complete(int(cqe.user_data), cqe.res);
+            cqHead++;
+            inFlight--;
+        }
+        __atomic_store_n(ring->cqHead, cqHead, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+void fail(IoUring::FileWrite &write, IoUring::Operation operation, int error)
+{
+    if (write.error == 0) {
+        write.error = error;
+        write.failedOperation = operation;
+    }
+}
+}
+#endif
+
+//! IoUring
+
+IoUring::IoUring(unsigned queueDepth)
+{
+#ifdef SIF_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(queueDepth, &params);
+    if (fd < 0) {
+        return; // not supported by the kernel, or forbidden (e.g. by seccomp)
+    }
+
+    ring = new Ring;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMapping) {
+        ring->sqRingSize = ring->cqRingSize = qMax(ring->sqRingSize, ring->cqRingSize);
+    }
+    ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cqRing = singleMapping ? ring->sqRing : mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe *>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        release();
+        return;
+    }
+
+    char *sq = static_cast<char *>(ring->sqRing);
+    char *cq = static_cast<char *>(ring->cqRing);
+    ring->sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // Opening and closing files through the ring needs Linux 5.6
+    const int probedOperationCount = 256; // every possible opcode
+    QByteArray probeData(int(sizeof(io_uring_probe) + probedOperationCount * sizeof(io_uring_probe_op)), '\0');
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(probeData.data());
+    bool supported = ioUringRegister(fd, IORING_REGISTER_PROBE, probe, probedOperationCount) == 0;
+    for (int operation : { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE }) {
+        supported = supported && operation <= probe->last_op && (probe->ops[operation].flags & IO_URING_OP_SUPPORTED);
+    }
+    if (!supported) {
+        release();
+    }
+#else
+    Q_UNUSED(queueDepth)
+#endif
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+bool IoUring::isValid() const
+{
+    return ring != nullptr;
+}
+
+void IoUring::release()
+{
+#ifdef SIF_IO_URING
+    if (!ring) {
+        return;
+    }
+    if (ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqesSize);
+    }
+    if (ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing) {
+        munmap(ring->cqRing, ring->cqRingSize);
+    }
+    if (ring->sqRing != MAP_FAILED) {
+        munmap(ring->sqRing, ring->sqRingSize);
+    }
+    close(ring->fd);
+    delete ring;
+    ring = nullptr;
+#endif
+}
+
+bool IoUring::writeFiles(FileWrite *writes, int count)
+{
+#ifdef SIF_IO_URING
+    if (!ring) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        writes[i].error = 0;
+        writes[i].writtenSize = 0;
+        writes[i].fd = -1;
+    }
+
+    // Open every file
+    bool ringWorks = runOperations(ring, count, [&](int i, io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = quint64(reinterpret_cast<quintptr>(writes[i].path.constData()));
+        sqe->len = writes[i].mode;
+        sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+        return true;
+    }, [&](int i, int result) {
+        if (result >= 0) {
+            writes[i].fd = result;
+        } else {
+            fail(writes[i], Open, -result);
+        }
+    });
+
+    int mask = processUmask();
+    for (int i = 0; i < count; i++) {
+        FileWrite &write = writes[i];
+        if (write.fd >= 0 && (mask < 0 || (write.mode & quint32(mask)) != 0) && fchmod(write.fd, mode_t(write.mode)) != 0) {
+            fail(write, SetPermissions, errno);
+        }
+    }
+
+    // Write them until every one is complete, short writes are queued again
+    bool writesPending = ringWorks;
+    while (writesPending && ringWorks) {
+        writesPending = false;
+        ringWorks = runOperations(ring, count, [&](int i, io_uring_sqe *sqe) {
+            const FileWrite &write = writes[i];
+            if (write.fd < 0 || write.error != 0 || write.writtenSize >= write.size) {
+                return false;
+            }
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = write.fd;
+            sqe->addr = quint64(reinterpret_cast<quintptr>(write.data + write.writtenSize));
+            sqe->len = unsigned(qMin(write.size - write.writtenSize, maxWriteSize));
+            sqe->off = quint64(write.writtenSize);
+            return true;
+        }, [&](int i, int result) {
+            if (result > 0) {
+                writes[i].writtenSize += result;
+                writesPending = writesPending || writes[i].writtenSize < writes[i].size;
+            } else if (result == -EINTR || result == -EAGAIN) {
+                writesPending = true;
+            } else {
+                fail(writes[i], Write, result < 0 ? -result : EIO);
+            }
+        });
+    }
+
+    // Sync the files that need it, all of them at once
+    if (ringWorks) {
+        ringWorks = runOperations(ring, count, [&](int i, io_uring_sqe *sqe) {
+            const FileWrite &write = writes[i];
+            if (!write.sync || write.fd < 0 || write.error != 0) {
+                return false;
+            }
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = write.fd;
+            return true;
+        }, [&](int i, int result) {
+            if (result < 0) {
+                fail(writes[i], Sync, -result);
+            }
+        });
+    }
+
+    // Close every opened file, even if something failed
+    bool closed = runOperations(ring, count, [&](int i, io_uring_sqe *sqe) {
+        if (writes[i].fd < 0) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = writes[i].fd;
+        return true;
+    }, [&](int i, int result) {
+        writes[i].fd = -1;
+        if (result < 0) {
+            fail(writes[i], Close, -result);
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        if (writes[i].fd >= 0) {
+            close(writes[i].fd); // the ring failed before closing it
+            writes[i].fd = -1;
+        }
+        if (!ringWorks && writes[i].error == 0 && (writes[i].writtenSize < writes[i].size || writes[i].sync)) {
+            fail(writes[i], writes[i].writtenSize < writes[i].size ? Write : Sync, EIO); // syncs may not have completed
+        }
+        if (writes[i].error != 0 && writes[i].failedOperation != Open) {
+            unlink(writes[i].path.constData());
+        }
+    }
+    return ringWorks && closed;
+#else
+    Q_UNUSED(writes)
+    Q_UNUSED(count)
+    return false;
+#endif
+}
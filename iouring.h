@@ -0,0 +1,55 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <QByteArray>
+
+// Minimal io_uring ring (Linux 5.6 or newer) that creates many files with a few system calls: opens, writes and
+// closes of a whole batch are queued together, and the kernel works on all of them while a single thread waits.
+// Talks to the kernel directly, so no liburing is needed. Invalid on other systems, and with older kernels or kernel
+// headers, where files must be written with QFile instead. Not thread-safe, every thread needs its own ring.
+class IoUring
+{
+public:
+    enum Operation { Open, SetPermissions, Write, Sync, Close };
+
+    struct FileWrite {
+        QByteArray path; // encoded with QFile::encodeName()
+        const char *data = nullptr;
+        qint64 size = 0;
+        quint32 mode = 0644; // POSIX permissions
+        bool sync = false; // whether the file is flushed to the disk before it is closed
+        int error = 0; // errno of the failed operation, 0 on success
+        Operation failedOperation = Open;
+        qint64 writtenSize = 0; // progress of the write, used internally
+        int fd = -1; // used internally
+    };
+
+    explicit IoUring(unsigned queueDepth = 64);
+    ~IoUring();
+
+    bool isValid() const;
+
+    // Creates every file, which must not exist, writes its data, syncs it if requested and closes it. Files that fail are removed.
+    // Returns false if the ring itself failed, otherwise every file has its own result
+    bool writeFiles(FileWrite *writes, int count);
+
+private:
+    struct Ring;
+    Ring *ring = nullptr;
+
+    void release();
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+};
+
+#endif // IOURING_H
@@ -0,0 +1,265 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "journal.h"
+#include "filelink.h"
+#include "filesync.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+
+namespace {
+const QByteArray journalHeader = "SIF journal 1\n";
+const QByteArray fileRecord = "file ";
+const QByteArray replaceRecord = "replace ";
+const QByteArray commitRecord = "commit\n";
+}
+
+QString Journal::journalPath(const QString &installationPath)
+{
+    QFileInfo installation(QDir::cleanPath(installationPath));
+    return installation.path() + "/." + installation.fileName() + ".sif-journal";
+}
+
+QString Journal::stagingPath(const QString &installationPath)
+{
+    QFileInfo installation(QDir::cleanPath(installationPath));
+    return installation.path() + "/." + installation.fileName() + ".sif-staging";
+}
+
+QString Journal::replacementPath(const QString &path)
+{
+    return path + ".sif-new";
+}
+
+bool Journal::begin(const QString &installationPath, bool staged)
+{
+    if (!recover(installationPath)) {
+        return false;
+    }
+
+    file.setFileName(journalPath(installationPath));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+        return fail(file.errorString());
+    }
+    active = true;
+    if (!append(journalHeader)) {
+        finish();
+        return false;
+    }
+
+    QString staging = stagingPath(installationPath);
+    QDir d;
+    if (staged && !d.mkpath(staging)) {
+        finish();
+        return fail(tr("Access denied to create the path: %1").arg(staging));
+    }
+    return true;
+}
+
+bool Journal::isActive() const
+{
+    return active;
+}
+
+bool Journal::recordFile(const QString &path)
+{
+    if (path.contains('\n')) {
+        return fail(tr("Unsupported file name: %1").arg(path));
+    }
+    {
+        QMutexLocker locker(&fileMutex);
+        files << path; // before the record, so a failed write is still rolled back by this process
+    }
+    return append(fileRecord + path.toUtf8() + '\n');
+}
+
+bool Journal::recordReplacement(const QString &path)
+{
+    if (path.contains('\n')) {
+        return fail(tr("Unsupported file name: %1").arg(path));
+    }
+    {
+        QMutexLocker locker(&fileMutex);
+        replacedFiles << path;
+    }
+    return append(replaceRecord + path.toUtf8() + '\n');
+}
+
+bool Journal::commit(bool durable)
+{
+    if (!append(commitRecord)) {
+        return false;
+    }
+    // The commit record must reach the disk before the rename, which must reach it before the journal is removed
+    QString parentPath = QFileInfo(QDir::cleanPath(installationPath)).path();
+    if (durable && (!FileSync::syncFile(file) || !FileSync::syncPath(parentPath))) {
+        return fail(tr("Unable to write the journal to the disk: %1").arg(file.fileName()));
+    }
+    file.close();
+    if (!moveStagingIntoPlace() || !replaceFiles(durable)) {
+        return false;
+    }
+    if (durable && !FileSync::syncPath(parentPath)) {
+        return fail(tr("Unable to write the installation to the disk: %1").arg(installationPath));
+    }
+    return finish();
+}
+
+bool Journal::rollback()
+{
+    file.close();
+    if (!removeStaging()) {
+        return false;
+    }
+    for (auto path : files) {
+        if (!removeFile(path)) {
+            return false;
+        }
+    }
+    for (auto path : replacedFiles) {
+        if (!removeFile(replacementPath(path))) {
+            return false;
+        }
+    }
+    return finish();
+}
+
+bool Journal::recover(const QString &value)
+{
+    installationPath = value;
+    files.clear();
+    replacedFiles.clear();
+    file.setFileName(journalPath(installationPath));
+    if (!file.exists()) {
+        return true;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(file.errorString());
+    }
+    if (file.readLine() != journalHeader) {
+        file.close();
+        return fail(tr("Unsupported installation journal: %1").arg(file.fileName()));
+    }
+    bool committed = false;
+    while (!file.atEnd()) {
+        QByteArray record = file.readLine();
+        if (!record.endsWith('\n')) {
+            break; // the process died while writing this record
+        } else if (record.startsWith(fileRecord)) {
+            files << QString::fromUtf8(record.mid(fileRecord.size(), record.size() - fileRecord.size() - 1));
+        } else if (record.startsWith(replaceRecord)) {
+            replacedFiles << QString::fromUtf8(record.mid(replaceRecord.size(), record.size() - replaceRecord.size() - 1));
+        } else if (record == commitRecord) {
+            committed = true;
+        }
+    }
+    file.close();
+
+    if (committed) {
+        // Only the renames or the removal of the journal may be missing
+        return moveStagingIntoPlace() && replaceFiles(true) && finish();
+    }
+    return rollback();
+}
+
+QString Journal::errorString() const
+{
+    return lastError;
+}
+
+bool Journal::append(const QByteArray &record)
+{
+    QMutexLocker locker(&fileMutex);
+    if (file.write(record) != record.size()) {
+        lastError = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool Journal::moveStagingIntoPlace()
+{
+    QString staging = stagingPath(installationPath);
+    QDir d;
+    if (!d.exists(staging)) {
+        return true; // already moved
+    }
+    // An empty installation directory may have been created by the user, the rename only replaces missing paths
+    if (d.exists(installationPath) && !d.rmdir(installationPath)) {
+        return fail(tr("The installation path is not empty: %1").arg(installationPath));
+    }
+    if (!d.rename(staging, installationPath)) {
+        return fail(tr("Unable to move %1 to %2").arg(staging).arg(installationPath));
+    }
+    return true;
+}
+
+bool Journal::replaceFiles(bool durable)
+{
+    // A new version that is gone was renamed already
+    QSet<QString> directories;
+    for (auto path : replacedFiles) {
+        QString replacement = replacementPath(path);
+        if (QFile::exists(replacement) && !FileLink::replace(replacement, path)) {
+            return fail(tr("Unable to replace the file: %1").arg(path));
+        }
+        directories.insert(QFileInfo(path).path());
+    }
+    for (auto directory : directories) {
+        if (durable && !FileSync::syncPath(directory)) {
+            return fail(tr("Unable to write the installation to the disk: %1").arg(directory));
+        }
+    }
+    return true;
+}
+
+bool Journal::removeStaging()
+{
+    QDir staging(stagingPath(installationPath));
+    if (staging.exists() && !staging.removeRecursively()) {
+        return fail(tr("Unable to remove the directory: %1").arg(staging.path()));
+    }
+    return true;
+}
+
+bool Journal::removeFile(const QString &path)
+{
+    if (QFile::exists(path) && !QFile::remove(path)) {
+        return fail(tr("Unable to remove the file: %1").arg(path));
+    }
+    // Updates create the directories of their new files in place, empty ones go away with them
+    QString root = QDir::cleanPath(installationPath);
+    QString directory = QFileInfo(path).path();
+    QDir d;
+    while (directory.startsWith(root + '/') && QDir(directory).isEmpty() && d.rmdir(directory)) {
+        directory = QFileInfo(directory).path();
+    }
+    return true;
+}
+
+bool Journal::finish()
+{
+    file.close();
+    active = false;
+    files.clear();
+    replacedFiles.clear();
+    if (file.exists() && !file.remove()) {
+        return fail(file.errorString());
+    }
+    return true;
+}
+
+bool Journal::fail(const QString &error)
+{
+    lastError = error;
+    return false;
+}
@@ -0,0 +1,67 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QStringList>
+
+// Journal of a transactional installation. Files are extracted into a staging directory next to the installation
+// path, which is renamed to the installation path on commit, or deleted as a whole on rollback. Updates have no
+// staging directory: their new files are journaled one by one, and new versions of installed files are written next
+// to them, then renamed over them on commit.
+// The journal is an append-only text file, next to the installation path too:
+//
+//   SIF journal 1
+//   file <path>     a file outside of the staging directory is about to be written
+//   replace <path>  a new version of the installed file is about to be written to replacementPath(<path>)
+//   commit          the staging directory and the new versions are complete and must be moved into place
+//
+// Records are written unbuffered, so they survive a killed process. When a journal is found, recover() either
+// finishes the commit or rolls back, without having to know which files were extracted to the staging directory.
+class Journal
+{
+    Q_DECLARE_TR_FUNCTIONS(Journal)
+
+public:
+    static QString journalPath(const QString &installationPath);
+    static QString stagingPath(const QString &installationPath);
+    static QString replacementPath(const QString &path);
+
+    bool begin(const QString &installationPath, bool staged = true); // recovers a previous journal first, if any
+    bool isActive() const;
+    bool recordFile(const QString &path); // thread-safe
+    bool recordReplacement(const QString &path); // thread-safe
+    bool commit(bool durable = false); // durable commits are flushed to the disk before the staging directory is moved
+    bool rollback();
+    bool recover(const QString &installationPath);
+    QString errorString() const;
+
+private:
+    QString installationPath;
+    QFile file;
+    QMutex fileMutex; // guards file, files and replacedFiles
+    QStringList files;
+    QStringList replacedFiles;
+    bool active = false;
+    QString lastError;
+
+    bool append(const QByteArray &record);
+    bool moveStagingIntoPlace();
+    bool replaceFiles(bool durable);
+    bool removeStaging();
+    bool removeFile(const QString &path);
+    bool finish();
+    bool fail(const QString &error);
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,151 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "manifest.h"
+
+void Manifest::clear()
+{
+    stringPool.clear();
+    directoryIndexes.clear();
+    directoryOffsets.clear();
+    directoryLengths.clear();
+    entryDirectories.clear();
+    nameOffsets.clear();
+    nameLengths.clear();
+    sizes.clear();
+    permissions.clear();
+    flags.clear();
+    sources.clear();
+}
+
+void Manifest::reserve(int entryCount)
+{
+    entryDirectories.reserve(entryCount);
+    nameOffsets.reserve(entryCount);
+    nameLengths.reserve(entryCount);
+    sizes.reserve(entryCount);
+    permissions.reserve(entryCount);
+    flags.reserve(entryCount);
+    sources.reserve(entryCount);
+}
+
+int Manifest::addDirectory(const QString &path)
+{
+    auto it = directoryIndexes.constFind(path);
+    if (it != directoryIndexes.constEnd()) {
+        return it.value();
+    }
+    int directory = directoryOffsets.size();
+    directoryLengths.append(path.size());
+    directoryOffsets.append(appendToPool(path));
+    directoryIndexes.insert(path, directory);
+    return directory;
+}
+
+int Manifest::addEntry(int directory, const QString &name, qint64 size, QFile::Permissions permissions, quint8 flags, int source)
+{
+    Q_ASSERT(directory >= 0 && directory < directoryOffsets.size());
+    Q_ASSERT(name.size() <= 0xFFFF);
+    int entry = entryDirectories.size();
+    entryDirectories.append(directory);
+    nameLengths.append(quint16(name.size()));
+    nameOffsets.append(appendToPool(name));
+    sizes.append(size);
+    this->permissions.append(quint16(int(permissions)));
+    this->flags.append(flags);
+    sources.append(source);
+    return entry;
+}
+
+int Manifest::addEntry(const QString &path, qint64 size, QFile::Permissions permissions, quint8 flags, int source)
+{
+    int separator = path.lastIndexOf('/');
+    int directory = addDirectory(separator < 0 ? QString() : path.left(qMax(separator, 1))); // keep the root directory
+    return addEntry(directory, path.mid(separator + 1), size, permissions, flags, source);
+}
+
+int Manifest::directoryCount() const
+{
+    return directoryOffsets.size();
+}
+
+QString Manifest::directoryPath(int directory) const
+{
+    return QString(stringPool.constData() + directoryOffsets.at(directory), directoryLengths.at(directory));
+}
+
+int Manifest::entryCount() const
+{
+    return entryDirectories.size();
+}
+
+int Manifest::entryDirectory(int entry) const
+{
+    return entryDirectories.at(entry);
+}
+
+QString Manifest::entryName(int entry) const
+{
+    return QString(stringPool.constData() + nameOffsets.at(entry), nameLengths.at(entry));
+}
+
+QString Manifest::entryPath(int entry) const
+{
+    int directory = entryDirectories.at(entry);
+    int directoryLength = directoryLengths.at(directory);
+    int nameLength = nameLengths.at(entry);
+    if (directoryLength == 0) {
+        return entryName(entry);
+    }
+
+    QString path;
+    path.reserve(directoryLength + 1 + nameLength);
+    path.append(stringPool.constData() + directoryOffsets.at(directory), directoryLength);
+    if (!path.endsWith('/')) {
+        path.append('/');
+    }
+    path.append(stringPool.constData() + nameOffsets.at(entry), nameLength);
+    return path;
+}
+
+qint64 Manifest::entrySize(int entry) const
+{
+    return sizes.at(entry);
+}
+
+QFile::Permissions Manifest::entryPermissions(int entry) const
+{
+    return QFile::Permissions(QFlag(permissions.at(entry)));
+}
+
+int Manifest::entrySource(int entry) const
+{
+    return sources.at(entry);
+}
+
+bool Manifest::testFlag(int entry, EntryFlag flag) const
+{
+    return flags.at(entry) & flag;
+}
+
+void Manifest::setFlag(int entry, EntryFlag flag, bool on)
+{
+    if (on) {
+        flags[entry] |= flag;
+    } else {
+        flags[entry] &= quint8(~flag);
+    }
+}
+
+int Manifest::appendToPool(const QString &value)
+{
+    int offset = stringPool.size();
+    stringPool.append(value);
+    return offset;
+}
@@ -0,0 +1,71 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Flat list of the files to install, stored as a struct of arrays.
+// Directory paths are interned, and every name lives in a single string pool, so an entry costs a few bytes
+// instead of a QFileInfo with its own copy of the whole path. Not thread-safe.
+class Manifest
+{
+public:
+    enum EntryFlag : quint8 {
+        NoFlags = 0x0,
+        Extracted = 0x1, // the file has been written to its destination
+        FromPayload = 0x2, // the source is the payload entry `source`
+        Additional = 0x4, // the source is the additional file `source`, and the directory is an absolute path
+        Unchanged = 0x8, // an update found the installed file up to date
+        Replaced = 0x10 // an update replaces the installed file
+    };
+
+    void clear();
+    void reserve(int entryCount);
+
+    int addDirectory(const QString &path); // returns the index of the directory, adding it only once
+    int addEntry(int directory, const QString &name, qint64 size, QFile::Permissions permissions, quint8 flags = NoFlags, int source = -1);
+    int addEntry(const QString &path, qint64 size, QFile::Permissions permissions, quint8 flags = NoFlags, int source = -1);
+
+    int directoryCount() const;
+    QString directoryPath(int directory) const;
+
+    int entryCount() const;
+    int entryDirectory(int entry) const;
+    QString entryName(int entry) const;
+    QString entryPath(int entry) const; // directory path and name
+    qint64 entrySize(int entry) const;
+    QFile::Permissions entryPermissions(int entry) const;
+    int entrySource(int entry) const;
+    bool testFlag(int entry, EntryFlag flag) const;
+    void setFlag(int entry, EntryFlag flag, bool on = true);
+
+private:
+    QString stringPool;
+    QHash<QString, int> directoryIndexes;
+
+    QVector<int> directoryOffsets;
+    QVector<int> directoryLengths;
+
+    QVector<int> entryDirectories;
+    QVector<int> nameOffsets;
+    QVector<quint16> nameLengths;
+    QVector<qint64> sizes;
+    QVector<quint16> permissions;
+    QVector<quint8> flags;
+    QVector<int> sources;
+
+    int appendToPool(const QString &value);
+};
+
+#endif // MANIFEST_H
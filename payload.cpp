@@ -0,0 +1,716 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "payload.h"
+#include "checksum.h"
+#include "delta.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+namespace {
+const char payloadMagic[8] = { 'S', 'I', 'F', 'P', 'A', 'Y', 'L', 'D' };
+const quint32 minimumFormatVersion = 1;
+const qint64 minimumDeltaFileSize = 64 * 1024; // smaller files are cheaper to store whole
+
+void setupStream(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+bool isSafeEntryPath(const QString &path)
+{
+    if (path.isEmpty() || path.startsWith('/') || path.startsWith(':') || path.contains('\\') || QDir::isAbsolutePath(path)) {
+        return false;
+    }
+    for (auto part : path.split('/')) {
+        if (part.isEmpty() || part == "." || part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readChunkRecord(QDataStream &stream, qint64 dataEnd, quint32 version, Payload::Chunk *chunk)
+{
+    quint8 compressionMethod;
+    stream >> chunk->offset >> chunk->storedSize >> chunk->size >> compressionMethod;
+    if (version >= 3) {
+        stream >> chunk->checksum;
+    }
+    // Offsets come from the payload, so they are compared without adding them, which could overflow. Sizes are bounded
+    // by the largest chunk the writer produces, so reading a chunk never allocates more than that
+    if (stream.status() != QDataStream::Ok || compressionMethod > Payload::Zlib || chunk->offset < Payload::headerSize
+            || chunk->size > Payload::chunkSizeLimit || chunk->storedSize > Payload::chunkSizeLimit
+            || chunk->storedSize > dataEnd || chunk->offset > dataEnd - chunk->storedSize) {
+        return false;
+    }
+    chunk->compressionMethod = Payload::CompressionMethod(compressionMethod);
+    return true;
+}
+
+void writeChunkRecord(QDataStream &stream, const Payload::Chunk &chunk)
+{
+    stream << chunk.offset << chunk.storedSize << chunk.size << quint8(chunk.compressionMethod) << chunk.checksum;
+}
+
+bool hashFile(QFile &file, qint64 blockSize, quint64 *checksum)
+{
+    Checksum hash;
+    while (!file.atEnd()) {
+        QByteArray data = file.read(blockSize);
+        if (data.isEmpty()) {
+            return false;
+        }
+        hash.addData(data.constData(), data.size());
+    }
+    *checksum = hash.result();
+    return file.seek(0);
+}
+
+bool haveSameContents(QFile &file, const QString &otherFilePath, qint64 blockSize, bool *equal)
+{
+    QFile other(otherFilePath);
+    if (!other.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    *equal = other.size() == file.size();
+    while (*equal && !file.atEnd()) {
+        QByteArray data = file.read(blockSize);
+        if (data.isEmpty()) {
+            return false;
+        }
+        *equal = other.read(data.size()) == data;
+    }
+    return file.seek(0);
+}
+}
+
+//! Payload
+
+Payload::Payload(const QString &fileName) : fileName(fileName)
+{
+}
+
+Payload::~Payload()
+{
+    close();
+}
+
+QString Payload::getFileName() const
+{
+    return fileName;
+}
+
+void Payload::setFileName(const QString &value)
+{
+    if (fileName != value) {
+        close();
+        fileName = value;
+    }
+}
+
+bool Payload::open()
+{
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(file.errorString());
+    }
+
+    QByteArray header = file.read(headerSize);
+    if (header.size() != headerSize || memcmp(header.constData(), payloadMagic, sizeof(payloadMagic)) != 0) {
+        return fail(tr("Not a SIF payload: %1").arg(fileName));
+    }
+    QDataStream headerStream(header);
+    setupStream(headerStream);
+    headerStream.skipRawData(int(sizeof(payloadMagic)));
+    quint32 version;
+    quint32 flags;
+    quint64 tableOfContentsOffset;
+    quint64 tableOfContentsSize;
+    headerStream >> version >> flags >> tableOfContentsOffset >> tableOfContentsSize;
+    if (version < minimumFormatVersion || version > formatVersion) {
+        return fail(tr("Unsupported SIF payload version %1: %2").arg(version).arg(fileName));
+    }
+    chunkChecksums = version >= 3;
+    quint64 tableOfContentsChecksumSize = chunkChecksums ? sizeof(quint64) : 0;
+    // The file is at least headerSize long, so these subtractions can't wrap, unlike adding the sizes from the header
+    quint64 fileSize = quint64(file.size());
+    if (tableOfContentsOffset < quint64(headerSize) || tableOfContentsSize > fileSize - tableOfContentsChecksumSize
+            || tableOfContentsOffset > fileSize - tableOfContentsChecksumSize - tableOfContentsSize) {
+        return fail(tr("Corrupted SIF payload: %1").arg(fileName));
+    }
+
+    if (!file.seek(qint64(tableOfContentsOffset))) {
+        return fail(file.errorString());
+    }
+    QByteArray compressedTableOfContents = file.read(qint64(tableOfContentsSize));
+    if (chunkChecksums) {
+        QByteArray tableOfContentsChecksum = file.read(qint64(tableOfContentsChecksumSize));
+        if (tableOfContentsChecksum.size() != int(tableOfContentsChecksumSize)
+                || qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(tableOfContentsChecksum.constData()))
+                       != Checksum::hash(compressedTableOfContents.constData(), compressedTableOfContents.size())) {
+            return fail(tr("Corrupted SIF payload table of contents: %1").arg(fileName));
+        }
+    }
+    QByteArray tableOfContents = qUncompress(compressedTableOfContents);
+    if (tableOfContents.isEmpty() || !readTableOfContents(tableOfContents, qint64(tableOfContentsOffset), version)) {
+        return fail(tr("Corrupted SIF payload table of contents: %1").arg(fileName));
+    }
+
+    // Resources that are not compressed by rcc, and files on disk, can be mapped in memory
+    mappedData = file.map(0, file.size());
+    lastError.clear();
+    return true;
+}
+
+bool Payload::readTableOfContents(const QByteArray &tableOfContents, qint64 dataEnd, quint32 version)
+{
+    QDataStream stream(tableOfContents);
+    setupStream(stream);
+
+    QVector<Chunk> packs;
+    quint32 largestChunkSize = 0;
+    if (version >= 4) {
+        quint32 packCount;
+        stream >> packCount;
+        if (stream.status() != QDataStream::Ok || packCount > quint32(tableOfContents.size())) {
+            return false;
+        }
+        packs.reserve(int(packCount));
+        for (quint32 i = 0; i < packCount; i++) {
+            Chunk pack;
+            if (!readChunkRecord(stream, dataEnd, version, &pack)) {
+                return false;
+            }
+            largestChunkSize = qMax(largestChunkSize, pack.size);
+            packs.append(pack);
+        }
+    }
+
+    quint32 entryCount;
+    stream >> entryCount;
+    if (stream.status() != QDataStream::Ok || entryCount > quint32(tableOfContents.size())) {
+        return false;
+    }
+
+    QVector<Entry> entries;
+    entries.reserve(int(entryCount));
+    qint64 totalSize = 0;
+    for (quint32 i = 0; i < entryCount; i++) {
+        Entry entry;
+        quint32 permissions;
+        quint32 chunkCount;
+        quint8 type = File;
+        stream >> entry.path >> entry.size >> permissions >> entry.checksum;
+        if (version >= 2) {
+            stream >> type;
+            if (type == Delta) {
+                stream >> entry.baseSize;
+            } else if (type == Duplicate && version >= 5) {
+                qint32 original;
+                stream >> original;
+                entry.original = original;
+            }
+        }
+        if (version >= 4) {
+            qint32 pack;
+            stream >> pack;
+            if (pack >= 0) {
+                entry.pack = pack;
+                stream >> entry.packOffset;
+            }
+        }
+        stream >> chunkCount;
+        EntryType lastType = version >= 5 ? Duplicate : Delta;
+        if (stream.status() != QDataStream::Ok || !isSafeEntryPath(entry.path) || entry.size < 0 || entry.size > std::numeric_limits<qint64>::max() - totalSize
+                || type > lastType || entry.baseSize < 0 || chunkCount > quint32(tableOfContents.size())) {
+            return false;
+        }
+        entry.type = EntryType(type);
+        entry.permissions = QFile::Permissions(QFlag(int(permissions)));
+
+        // Duplicates have the contents of a previous file entry, and no data of their own
+        if (entry.type == Duplicate) {
+            if (entry.original < 0 || entry.original >= entries.size() || entries.at(entry.original).type != File || entry.pack >= 0 || chunkCount > 0
+                    || entries.at(entry.original).size != entry.size || entries.at(entry.original).checksum != entry.checksum) {
+                return false;
+            }
+            totalSize += entry.size;
+            entries.append(entry);
+            continue;
+        }
+
+        // Packed files are a slice of their pack
+        if (entry.pack >= 0) {
+            if (entry.type != File || chunkCount > 0 || entry.pack >= packs.size() || entry.packOffset + quint64(entry.size) > packs.at(entry.pack).size) {
+                return false;
+            }
+            totalSize += entry.size;
+            entries.append(entry);
+            continue;
+        }
+
+        entry.chunks.reserve(int(chunkCount));
+        qint64 chunksSize = 0;
+        for (quint32 j = 0; j < chunkCount; j++) {
+            Chunk chunk;
+            if (!readChunkRecord(stream, dataEnd, version, &chunk)) {
+                return false;
+            }
+            chunksSize += chunk.size;
+            largestChunkSize = qMax(largestChunkSize, chunk.size);
+            entry.chunks.append(chunk);
+        }
+        if (entry.type == File && chunksSize != entry.size) { // chunks of deltas hold instructions, not the file
+            return false;
+        }
+
+        totalSize += entry.size;
+        entries.append(entry);
+    }
+
+    payloadEntries = entries;
+    payloadPacks = packs;
+    payloadTotalSize = totalSize;
+    payloadMaxChunkSize = largestChunkSize;
+    return true;
+}
+
+void Payload::close()
+{
+    QMutexLocker locker(&fileMutex);
+    if (mappedData) {
+        file.unmap(const_cast<uchar *>(mappedData));
+        mappedData = nullptr;
+    }
+    file.close();
+    payloadEntries.clear();
+    payloadPacks.clear();
+    payloadTotalSize = 0;
+    payloadMaxChunkSize = 0;
+    chunkChecksums = false;
+}
+
+bool Payload::isOpen() const
+{
+    return file.isOpen();
+}
+
+QString Payload::errorString() const
+{
+    return lastError;
+}
+
+const QVector<Payload::Entry> &Payload::entries() const
+{
+    return payloadEntries;
+}
+
+const QVector<Payload::Chunk> &Payload::packs() const
+{
+    return payloadPacks;
+}
+
+qint64 Payload::totalSize() const
+{
+    return payloadTotalSize;
+}
+
+quint32 Payload::maxChunkSize() const
+{
+    return payloadMaxChunkSize;
+}
+
+bool Payload::isMapped() const
+{
+    return mappedData;
+}
+
+bool Payload::readChunk(const Chunk &chunk, QByteArray *data, QString *errorString) const
+{
+    QByteArray storedData;
+    if (mappedData) {
+        storedData = QByteArray::fromRawData(reinterpret_cast<const char *>(mappedData + chunk.offset), int(chunk.storedSize));
+    } else if (chunk.compressionMethod == Stored) {
+        // Read in place, so a reused buffer is not replaced by a new allocation
+        data->resize(int(chunk.storedSize));
+        QMutexLocker locker(&fileMutex);
+        if (!file.seek(chunk.offset)) {
+            *errorString = file.errorString();
+            return false;
+        }
+        if (file.read(data->data(), chunk.storedSize) != qint64(chunk.storedSize)) {
+            *errorString = tr("Unable to read from the payload: %1").arg(fileName);
+            return false;
+        }
+        storedData = *data;
+    } else {
+        QMutexLocker locker(&fileMutex);
+        if (!file.seek(chunk.offset)) {
+            *errorString = file.errorString();
+            return false;
+        }
+        storedData = file.read(chunk.storedSize);
+    }
+    if (storedData.size() != int(chunk.storedSize)) {
+        *errorString = tr("Unable to read from the payload: %1").arg(fileName);
+        return false;
+    }
+
+    if (chunk.compressionMethod == Stored) {
+        *data = storedData;
+    } else {
+        *data = qUncompress(storedData);
+    }
+    if (data->size() != int(chunk.size) || (chunkChecksums && Checksum::hash(data->constData(), data->size()) != chunk.checksum)) {
+        *errorString = tr("Corrupted chunk in the payload: %1").arg(fileName);
+        return false;
+    }
+    return true;
+}
+
+bool Payload::hasChunkChecksums() const
+{
+    return chunkChecksums;
+}
+
+bool Payload::fail(const QString &error)
+{
+    close();
+    lastError = error;
+    return false;
+}
+
+//! PayloadWriter
+
+PayloadWriter::PayloadWriter(const QString &fileName, qint64 chunkSize, int compressionLevel, qint64 maxPackedFileSize, bool deduplicate)
+    : file(fileName), chunkSize(chunkSize), compressionLevel(compressionLevel), maxPackedFileSize(qMin(maxPackedFileSize, chunkSize)),
+      deduplicate(deduplicate)
+{
+}
+
+bool PayloadWriter::open()
+{
+    if (chunkSize <= 0 || chunkSize > Payload::chunkSizeLimit) {
+        return fail(tr("Invalid chunk size: %1").arg(chunkSize));
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return fail(file.errorString());
+    }
+    payloadEntries.clear();
+    payloadPacks.clear();
+    pendingPack.clear();
+    contentEntries.clear();
+    contentSourcePaths.clear();
+    return writeHeader(0, 0); // rewritten by finish()
+}
+
+bool PayloadWriter::addFile(const QString &sourceFilePath, const QString &entryPath, const QString &baseFilePath)
+{
+    if (!isSafeEntryPath(entryPath)) {
+        return fail(tr("Invalid entry path: %1").arg(entryPath));
+    }
+    QFile in(sourceFilePath);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return fail(tr("Cannot open \'%1\': %2").arg(sourceFilePath, in.errorString()));
+    }
+
+    Payload::Entry entry;
+    entry.path = entryPath;
+    entry.permissions = in.permissions();
+
+    if (deduplicate && in.size() > 0) {
+        bool added;
+        if (!addDuplicate(in, &entry, &added)) {
+            return false;
+        } else if (added) {
+            payloadEntries.append(entry);
+            return true;
+        }
+    }
+
+    QFile base(baseFilePath);
+    if (!baseFilePath.isEmpty() && in.size() >= minimumDeltaFileSize && base.open(QIODevice::ReadOnly)) {
+        bool added;
+        if (!addDelta(in, base, &entry, &added)) {
+            return false;
+        } else if (added) {
+            payloadEntries.append(entry);
+            return true;
+        }
+    }
+
+    if (in.size() > 0 && in.size() <= maxPackedFileSize) {
+        QByteArray data = in.readAll();
+        if (data.size() != in.size()) {
+            return fail(tr("Unable to read from \'%1\': %2").arg(sourceFilePath, in.errorString()));
+        }
+        if (!addPackedFile(data, &entry)) {
+            return false;
+        }
+        addContent(payloadEntries.size() - 1, sourceFilePath);
+        return true;
+    }
+
+    Checksum checksum;
+    while (!in.atEnd()) {
+        QByteArray data = in.read(chunkSize);
+        if (data.isEmpty()) {
+            return fail(tr("Unable to read from \'%1\': %2").arg(sourceFilePath, in.errorString()));
+        }
+        checksum.addData(data.constData(), data.size());
+        Payload::Chunk chunk;
+        if (!writeChunk(data, &chunk)) {
+            return false;
+        }
+        entry.chunks.append(chunk);
+        entry.size += data.size();
+    }
+    entry.checksum = checksum.result();
+
+    payloadEntries.append(entry);
+    addContent(payloadEntries.size() - 1, sourceFilePath);
+    return true;
+}
+
+bool PayloadWriter::addDuplicate(QFile &in, Payload::Entry *entry, bool *added)
+{
+    *added = false;
+    quint64 checksum;
+    if (!hashFile(in, chunkSize, &checksum)) {
+        return fail(tr("Unable to read from \'%1\': %2").arg(in.fileName(), in.errorString()));
+    }
+
+    // Files with the same checksum are compared byte by byte, a collision must not install the wrong contents
+    for (int candidate : contentEntries.values(checksum)) {
+        if (payloadEntries.at(candidate).size != in.size()) {
+            continue;
+        }
+        bool equal;
+        if (!haveSameContents(in, contentSourcePaths.value(candidate), chunkSize, &equal)) {
+            return fail(tr("Unable to read from \'%1\': %2").arg(contentSourcePaths.value(candidate), in.errorString()));
+        } else if (equal) {
+            entry->type = Payload::Duplicate;
+            entry->size = in.size();
+            entry->checksum = checksum;
+            entry->original = candidate;
+            *added = true;
+            return true;
+        }
+    }
+    return true;
+}
+
+void PayloadWriter::addContent(int entry, const QString &sourceFilePath)
+{
+    if (deduplicate && payloadEntries.at(entry).size > 0) {
+        contentEntries.insert(payloadEntries.at(entry).checksum, entry);
+        contentSourcePaths.insert(entry, sourceFilePath);
+    }
+}
+
+bool PayloadWriter::addDelta(QFile &in, QFile &base, Payload::Entry *entry, bool *added)
+{
+    *added = false;
+    const uchar *source = in.map(0, in.size());
+    const uchar *previousVersion = base.size() > 0 ? base.map(0, base.size()) : nullptr;
+    if (!source || (base.size() > 0 && !previousVersion)) {
+        return true; // not worth it without mapping the files, store the whole file
+    }
+
+    // A delta must save at least half of the file
+    QByteArray delta;
+    bool deltaIsSmaller = Delta::create(reinterpret_cast<const char *>(previousVersion), base.size(), reinterpret_cast<const char *>(source), in.size(),
+                                        in.size() / 2, &delta);
+    if (deltaIsSmaller) {
+        entry->type = Payload::Delta;
+        entry->size = in.size();
+        entry->baseSize = base.size();
+        entry->checksum = Checksum::hash(reinterpret_cast<const char *>(source), in.size());
+        for (int offset = 0; offset < delta.size(); offset += int(chunkSize)) {
+            Payload::Chunk chunk;
+            if (!writeChunk(delta.mid(offset, int(chunkSize)), &chunk)) {
+                return false;
+            }
+            entry->chunks.append(chunk);
+        }
+        *added = true;
+    }
+    in.unmap(const_cast<uchar *>(source));
+    if (previousVersion) {
+        base.unmap(const_cast<uchar *>(previousVersion));
+    }
+    return true;
+}
+
+bool PayloadWriter::addPackedFile(const QByteArray &data, Payload::Entry *entry)
+{
+    if (pendingPack.size() + data.size() > chunkSize && !writePendingPack()) {
+        return false;
+    }
+    entry->size = data.size();
+    entry->checksum = Checksum::hash(data.constData(), data.size());
+    entry->pack = payloadPacks.size(); // the pack is added when written
+    entry->packOffset = quint32(pendingPack.size());
+    pendingPack.append(data);
+    payloadEntries.append(*entry);
+    return true;
+}
+
+bool PayloadWriter::writePendingPack()
+{
+    if (pendingPack.isEmpty()) {
+        return true;
+    }
+    Payload::Chunk pack;
+    if (!writeChunk(pendingPack, &pack)) {
+        return false;
+    }
+    payloadPacks.append(pack);
+    pendingPack.clear();
+    return true;
+}
+
+bool PayloadWriter::writeChunk(const QByteArray &data, Payload::Chunk *chunk)
+{
+    chunk->offset = file.pos();
+    chunk->size = quint32(data.size());
+    chunk->checksum = Checksum::hash(data.constData(), data.size());
+    QByteArray storedData = data;
+    if (compressionLevel != 0) {
+        // qCompress() prefixes the data with its uncompressed size, already known from the TOC
+        QByteArray compressedData = qCompress(data, compressionLevel);
+        if (compressedData.size() < data.size()) { // already compressed files are stored as they are
+            storedData = compressedData;
+            chunk->compressionMethod = Payload::Zlib;
+        }
+    }
+    chunk->storedSize = quint32(storedData.size());
+    if (file.write(storedData) != storedData.size()) {
+        return fail(file.errorString());
+    }
+    return true;
+}
+
+bool PayloadWriter::addDirectory(const QString &directoryPath, const QString &baseDirectoryPath)
+{
+    QDir directory(directoryPath);
+    if (!directory.exists()) {
+        return fail(tr("The directory \'%1\' does not exists").arg(directoryPath));
+    }
+
+    // Sort the files, so the same tree always produces the same payload
+    QStringList filePaths;
+    QDirIterator it(directoryPath, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        filePaths << it.next();
+    }
+    filePaths.sort();
+
+    for (auto filePath : filePaths) {
+        QString entryPath = directory.relativeFilePath(filePath);
+        QString baseFilePath = baseDirectoryPath.isEmpty() ? QString() : baseDirectoryPath + '/' + entryPath;
+        if (!addFile(filePath, entryPath, QFile::exists(baseFilePath) ? baseFilePath : QString())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PayloadWriter::finish()
+{
+    if (!writePendingPack()) {
+        return false;
+    }
+
+    QByteArray tableOfContents;
+    QDataStream stream(&tableOfContents, QIODevice::WriteOnly);
+    setupStream(stream);
+    stream << quint32(payloadPacks.size());
+    for (auto pack : payloadPacks) {
+        writeChunkRecord(stream, pack);
+    }
+    stream << quint32(payloadEntries.size());
+    for (auto entry : payloadEntries) {
+        stream << entry.path << entry.size << quint32(entry.permissions) << entry.checksum << quint8(entry.type);
+        if (entry.type == Payload::Delta) {
+            stream << entry.baseSize;
+        } else if (entry.type == Payload::Duplicate) {
+            stream << qint32(entry.original);
+        }
+        stream << qint32(entry.pack);
+        if (entry.pack >= 0) {
+            stream << entry.packOffset;
+        }
+        stream << quint32(entry.chunks.size());
+        for (auto chunk : entry.chunks) {
+            writeChunkRecord(stream, chunk);
+        }
+    }
+
+    QByteArray compressedTableOfContents = qCompress(tableOfContents, 9);
+    quint64 tableOfContentsOffset = quint64(file.pos());
+    QByteArray tableOfContentsChecksum(sizeof(quint64), Qt::Uninitialized);
+    qToLittleEndian<quint64>(Checksum::hash(compressedTableOfContents.constData(), compressedTableOfContents.size()),
+                             reinterpret_cast<uchar *>(tableOfContentsChecksum.data()));
+    if (file.write(compressedTableOfContents) != compressedTableOfContents.size() || file.write(tableOfContentsChecksum) != tableOfContentsChecksum.size()) {
+        return fail(file.errorString());
+    }
+    if (!file.seek(0) || !writeHeader(tableOfContentsOffset, quint64(compressedTableOfContents.size()))) {
+        return fail(file.errorString());
+    }
+    file.close();
+    return true;
+}
+
+bool PayloadWriter::writeHeader(quint64 tableOfContentsOffset, quint64 tableOfContentsSize)
+{
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    setupStream(stream);
+    stream.writeRawData(payloadMagic, int(sizeof(payloadMagic)));
+    stream << quint32(Payload::formatVersion) << quint32(0) << tableOfContentsOffset << tableOfContentsSize;
+    if (file.write(header) != Payload::headerSize) {
+        return fail(file.errorString());
+    }
+    return true;
+}
+
+QString PayloadWriter::errorString() const
+{
+    return lastError;
+}
+
+const QVector<Payload::Entry> &PayloadWriter::entries() const
+{
+    return payloadEntries;
+}
+
+const QVector<Payload::Chunk> &PayloadWriter::packs() const
+{
+    return payloadPacks;
+}
+
+bool PayloadWriter::fail(const QString &error)
+{
+    if (file.isOpen()) {
+        file.close();
+        file.remove();
+    }
+    lastError = error;
+    return false;
+}
@@ -0,0 +1,157 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include <limits>
+
+// A SIF payload is a single file holding every file to install. Its layout is (little-endian):
+//
+//   header | magic "SIFPAYLD", format version (quint32), flags (quint32), TOC offset (quint64), TOC size (quint64)
+//   data   | contents of every entry, split in chunks that are compressed independently
+//   TOC    | zlib-compressed table of contents: packs, then path, size, permissions, checksum, type and chunks of every
+//          | entry, followed by the checksum of the compressed table of contents (quint64)
+//
+// Every chunk has the checksum of its uncompressed data, verified as soon as it is read, so the whole payload is
+// verified while it is extracted.
+// Small files are packed together: a pack is a single chunk holding the contents of many files one after another, so
+// they are read, decompressed and verified at once. Packed entries have no chunks of their own.
+// The chunks of a delta entry hold a Delta against the previous version of the file, which must be installed.
+// Files with the same contents are stored once: the next ones are duplicate entries, with no data of their own, that
+// refer to the first one, so the installer can link or clone it instead of writing the contents again.
+// The whole table of contents is read at once when the payload is opened, so no directory walking is needed.
+class Payload
+{
+    Q_DECLARE_TR_FUNCTIONS(Payload)
+
+public:
+    enum CompressionMethod : quint8 { Stored, Zlib };
+    enum EntryType : quint8 { File, Delta, Duplicate };
+
+    struct Chunk {
+        qint64 offset = 0; // position of the stored data in the payload
+        quint32 storedSize = 0;
+        quint32 size = 0; // uncompressed size
+        CompressionMethod compressionMethod = Stored;
+        quint64 checksum = 0; // XXH64 of the uncompressed data, since version 3
+    };
+
+    struct Entry {
+        QString path; // relative to the installation path, '/' separated
+        qint64 size = 0;
+        QFile::Permissions permissions;
+        quint64 checksum = 0; // XXH64 of the uncompressed contents, see Checksum
+        EntryType type = File;
+        qint64 baseSize = 0; // delta entries only, size of the previous version of the file
+        int pack = -1; // packed entries only, index of the pack holding the contents
+        quint32 packOffset = 0; // packed entries only, position of the contents in the uncompressed pack
+        int original = -1; // duplicate entries only, index of the previous file entry with the same contents
+        QVector<Chunk> chunks;
+    };
+
+    // Version 1 has no delta entries, versions 1 and 2 have no checksums of chunks, versions 1 to 3 have no packs,
+    // versions 1 to 4 have no duplicate entries
+    static const quint32 formatVersion = 5;
+    static const int headerSize = 32;
+    static const qint64 defaultChunkSize = 1024 * 1024; // 1 MiB
+    // Largest chunk or pack the writer produces, uncompressed or stored, so it always fits in a QByteArray
+    static const qint64 chunkSizeLimit = std::numeric_limits<int>::max() / 2;
+    static const qint64 defaultMaxPackedFileSize = 16 * 1024; // 16 KiB
+
+    explicit Payload(const QString &fileName = QString());
+    ~Payload();
+
+    QString getFileName() const;
+    void setFileName(const QString &value);
+
+    bool open();
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    const QVector<Entry> &entries() const;
+    const QVector<Chunk> &packs() const;
+    qint64 totalSize() const;
+    quint32 maxChunkSize() const; // uncompressed size of the largest chunk or pack
+    bool hasChunkChecksums() const;
+    bool isMapped() const;
+
+    // Thread-safe. Stored chunks of a memory-mapped payload are returned without copying them, other stored chunks are
+    // read into the memory already owned by *data when it is large enough.
+    // The checksum of the chunk is verified while its data is still in the cache of the calling thread
+    bool readChunk(const Chunk &chunk, QByteArray *data, QString *errorString) const;
+
+private:
+    QString fileName;
+    mutable QFile file;
+    mutable QMutex fileMutex; // guards seeking when the payload cannot be memory-mapped
+    const uchar *mappedData = nullptr;
+    QVector<Entry> payloadEntries;
+    QVector<Chunk> payloadPacks;
+    qint64 payloadTotalSize = 0;
+    quint32 payloadMaxChunkSize = 0;
+    bool chunkChecksums = false;
+    QString lastError;
+
+    bool fail(const QString &error);
+    bool readTableOfContents(const QByteArray &tableOfContents, qint64 dataEnd, quint32 version);
+};
+
+// Writes SIF payloads. Used by the `sifpack` tool at build time
+class PayloadWriter
+{
+    Q_DECLARE_TR_FUNCTIONS(PayloadWriter)
+
+public:
+    // Files up to maxPackedFileSize are packed together, in packs of up to chunkSize. 0 disables packing.
+    // Files with the same contents as a previous one are stored as duplicates, unless deduplicate is false
+    explicit PayloadWriter(const QString &fileName, qint64 chunkSize = Payload::defaultChunkSize, int compressionLevel = -1,
+                           qint64 maxPackedFileSize = Payload::defaultMaxPackedFileSize, bool deduplicate = true);
+
+    bool open();
+    // With a previous version of the file, a delta is stored instead when it is small enough
+    bool addFile(const QString &sourceFilePath, const QString &entryPath, const QString &baseFilePath = QString());
+    bool addDirectory(const QString &directoryPath, const QString &baseDirectoryPath = QString());
+    bool finish();
+    QString errorString() const;
+
+    const QVector<Payload::Entry> &entries() const;
+    const QVector<Payload::Chunk> &packs() const;
+
+private:
+    QFile file;
+    qint64 chunkSize;
+    int compressionLevel;
+    qint64 maxPackedFileSize;
+    bool deduplicate;
+    QVector<Payload::Entry> payloadEntries;
+    QMultiHash<quint64, int> contentEntries; // checksum -> file entries that may be the original of a duplicate
+    QHash<int, QString> contentSourcePaths; // file entry -> source file, to compare the contents of possible duplicates
+    QVector<Payload::Chunk> payloadPacks;
+    QByteArray pendingPack; // contents of the pack being filled, written when full
+    QString lastError;
+
+    bool fail(const QString &error);
+    bool addDuplicate(QFile &in, Payload::Entry *entry, bool *added);
+    bool addDelta(QFile &in, QFile &base, Payload::Entry *entry, bool *added);
+    void addContent(int entry, const QString &sourceFilePath);
+    bool addPackedFile(const QByteArray &data, Payload::Entry *entry);
+    bool writePendingPack();
+    bool writeChunk(const QByteArray &data, Payload::Chunk *chunk);
+    bool writeHeader(quint64 tableOfContentsOffset, quint64 tableOfContentsSize);
+};
+
+#endif // PAYLOAD_H
@@ -0,0 +1,439 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <cstdio>
+#include <cstring>
+
+#include "installer.h"
+#include "payload.h"
+
+namespace {
+struct FileGroup {
+    int count;
+    qint64 minSize;
+    qint64 maxSize;
+};
+
+// Files are spread over `breadth` chains of `depth` nested directories
+struct Scenario {
+    QString name;
+    int breadth;
+    int depth;
+    QVector<FileGroup> groups;
+};
+
+struct Run {
+    bool succeeded = false;
+    bool reverted = false;
+    QString errorString;
+    qint64 scanTime = -1; // ms, from the start until the first file can be extracted
+    qint64 extractionTime = -1; // ms
+    qint64 totalTime = -1; // ms
+    qint64 rollbackTime = -1; // ms
+    QVariantMap phases; // trace summary, only if traced
+};
+
+struct IoCounters {
+    qint64 readCalls = -1;
+    qint64 writeCalls = -1;
+};
+
+const qint64 KiB = 1024;
+const qint64 MiB = 1024 * 1024;
+const qint64 generationBlockSize = MiB;
+
+QVector<Scenario> scenarios(double scale)
+{
+    auto scaled = [scale](qint64 value) {
+        return qMax<qint64>(1, qint64(value * scale));
+    };
+    return {
+        { "tiny", 200, 1, { { int(scaled(20000)), 256, 4 * KiB } } },
+        { "huge", 1, 1, { { 4, scaled(64 * MiB), scaled(64 * MiB) } } },
+        { "deep", 4, 64, { { int(scaled(2048)), 4 * KiB, 64 * KiB } } },
+        { "mixed", 50, 4, { { int(scaled(5000)), 256, 4 * KiB }, { int(scaled(500)), 64 * KiB, MiB }, { 4, scaled(32 * MiB), scaled(32 * MiB) } } }
+    };
+}
+
+// Deterministic contents, half random and half repetitive, so payloads compress like real applications
+class Generator
+{
+public:
+    quint64 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    qint64 nextSize(qint64 minSize, qint64 maxSize)
+    {
+        return minSize + qint64(next() % quint64(maxSize - minSize + 1));
+    }
+
+    void fill(char *data, qint64 size)
+    {
+        for (qint64 i = 0; i < size / 2; i += 8) {
+            quint64 value = next();
+            memcpy(data + i, &value, size_t(qMin<qint64>(8, size / 2 - i)));
+        }
+        for (qint64 i = size / 2; i < size; i++) {
+            data[i] = char('a' + i % 16);
+        }
+    }
+
+private:
+    quint64 state = Q_UINT64_C(0x9E3779B97F4A7C15);
+};
+
+QString directoryPath(const Scenario &scenario, int directory)
+{
+    QString path = "chain" + QString::number(directory / scenario.depth);
+    for (int level = 1; level <= directory % scenario.depth; level++) {
+        path += "/level" + QString::number(level);
+    }
+    return path;
+}
+
+bool generateScenario(const Scenario &scenario, const QString &sourcePath, int *fileCount, qint64 *totalSize)
+{
+    Generator generator;
+    QByteArray block(int(generationBlockSize), Qt::Uninitialized);
+    int directoryCount = scenario.breadth * scenario.depth;
+    int file = 0;
+    *totalSize = 0;
+    for (auto group : scenario.groups) {
+        for (int i = 0; i < group.count; i++, file++) {
+            QString path = sourcePath + '/' + directoryPath(scenario, file % directoryCount);
+            if (!QDir().mkpath(path)) {
+                qCritical("Unable to create \'%s\'", qPrintable(path));
+                return false;
+            }
+            QFile out(path + "/file" + QString::number(file) + ".bin");
+            if (!out.open(QIODevice::WriteOnly)) {
+                qCritical("Unable to create \'%s\': %s", qPrintable(out.fileName()), qPrintable(out.errorString()));
+                return false;
+            }
+            qint64 size = generator.nextSize(group.minSize, group.maxSize);
+            for (qint64 written = 0; written < size; written += block.size()) {
+                qint64 blockSize = qMin(size - written, qint64(block.size()));
+                generator.fill(block.data(), blockSize);
+                if (out.write(block.constData(), blockSize) != blockSize) {
+                    qCritical("Unable to write \'%s\': %s", qPrintable(out.fileName()), qPrintable(out.errorString()));
+                    return false;
+                }
+            }
+            *totalSize += size;
+        }
+    }
+    *fileCount = file;
+    return true;
+}
+
+IoCounters readIoCounters()
+{
+    IoCounters counters;
+    QFile io("/proc/self/io"); // Linux only, counts the system calls of every thread of the process
+    if (!io.open(QIODevice::ReadOnly)) {
+        return counters;
+    }
+    for (auto line : io.readAll().split('\n')) {
+        if (line.startsWith("syscr: ")) {
+            counters.readCalls = line.mid(7).toLongLong();
+        } else if (line.startsWith("syscw: ")) {
+            counters.writeCalls = line.mid(7).toLongLong();
+        }
+    }
+    return counters;
+}
+
+void resetPeakMemory()
+{
+    QFile clearRefs("/proc/self/clear_refs"); // Linux only, "5" resets the peak resident set size
+    if (clearRefs.open(QIODevice::WriteOnly)) {
+        clearRefs.write("5");
+    }
+}
+
+qint64 peakMemory() // KiB
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (auto line : status.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+Run runInstaller(const QString &dataPath, const QString &payloadPath, const QString &installationPath, bool cancelHalfway, bool traced, Installer::IoBackend ioBackend, Installer::Durability durability, qint64 memoryLimit)
+{
+    Run run;
+    Installer installer;
+    installer.setDataPath(dataPath);
+    installer.setPayloadPath(payloadPath);
+    installer.setInstallationPath(installationPath);
+    installer.setProgressInterval(cancelHalfway ? 10 : 0);
+    installer.setTracingEnabled(traced);
+    installer.setIoBackend(ioBackend);
+    installer.setDurability(durability);
+    installer.setMemoryLimit(memoryLimit);
+
+    QElapsedTimer clock;
+    QAtomicInteger<qint64> extractionStart = -1;
+    QAtomicInteger<qint64> revertStart = -1;
+    QEventLoop loop;
+
+    // Status changes are timed on the thread that makes them
+    QObject::connect(&installer, &Installer::installerStatusChanged, [&](Installer::InstallerStatus status) {
+        qint64 now = clock.elapsed();
+        switch (status) {
+        case Installer::ExtractingPackages:
+            extractionStart.storeRelease(now);
+            break;
+        case Installer::RevertingInstallation:
+            revertStart.storeRelease(now);
+            break;
+        case Installer::ExtractionFinished:
+            run.succeeded = true;
+            run.scanTime = extractionStart.loadAcquire();
+            run.extractionTime = now - extractionStart.loadAcquire();
+            run.totalTime = now;
+            QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+            break;
+        case Installer::ExtractionCanceled:
+            run.reverted = true;
+            run.rollbackTime = now - revertStart.loadAcquire();
+            QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+            break;
+        case Installer::ErrorOccurred:
+            QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+            break;
+        default:
+            break;
+        }
+    });
+    QObject::connect(&installer, &Installer::extractionError, &loop, [&](QFile::FileError, const QString &errorString) {
+        run.errorString = errorString;
+    });
+    if (cancelHalfway) {
+        QObject::connect(&installer, &Installer::progressChanged, &loop, [&]() {
+            if (installer.getInstallerStatus() == Installer::ExtractingPackages && installer.getProgress() >= 0.5) {
+                installer.cancel();
+            }
+        });
+    }
+
+    clock.start();
+    installer.extractAll();
+    loop.exec();
+    QThreadPool::globalInstance()->waitForDone(); // the extraction may still be leaving after an error
+    if (traced) {
+        run.phases = installer.getTraceSummary();
+    }
+    return run;
+}
+
+void print(const QJsonObject &result)
+{
+    QByteArray line = QJsonDocument(result).toJson(QJsonDocument::Compact);
+    fprintf(stdout, "%s\n", line.constData());
+    fflush(stdout);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sifbench");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the extraction pipeline of SIF on synthetic payloads. Results are printed as JSON lines");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption scenarioOption(QStringList() << "s" << "scenario", "Scenario to run: tiny, huge, deep, mixed or all (all by default).", "name", "all");
+    QCommandLineOption modeOption(QStringList() << "m" << "mode", "Source of the files: data (a directory), payload or both (both by default).", "mode", "both");
+    QCommandLineOption scaleOption("scale", "Multiplies the number and size of the files (1 by default).", "factor", "1");
+    QCommandLineOption repeatOption(QStringList() << "r" << "repeat", "Number of times every measurement is repeated (1 by default).", "count", "1");
+    QCommandLineOption workDirectoryOption(QStringList() << "w" << "work-dir", "Directory where the files are generated and installed (the temporary directory by default).", "directory", QDir::tempPath());
+    QCommandLineOption levelOption(QStringList() << "l" << "level", "Compression level of the payloads, from 0 to 9 (9 by default).", "level", "9");
+    parser.addOption(scenarioOption);
+    parser.addOption(modeOption);
+    parser.addOption(scaleOption);
+    parser.addOption(repeatOption);
+    parser.addOption(workDirectoryOption);
+    parser.addOption(levelOption);
+    QCommandLineOption phasesOption("phases", "Traces the installer and reports the time spent in every phase (scan, mkdir, open, copy, fsync, permissions, rollback).");
+    parser.addOption(phasesOption);
+    QCommandLineOption ioBackendOption("io-backend", "How payload files are written: qfile or io_uring (qfile by default).", "backend", "qfile");
+    parser.addOption(ioBackendOption);
+    QCommandLineOption durabilityOption("durability", "How installed files are flushed to disk: none, batched or strict (batched by default).", "mode", "batched");
+    parser.addOption(durabilityOption);
+    QCommandLineOption memoryLimitOption("memory-limit", "Memory the installer may use for I/O buffers, in MiB (64 by default).", "MiB", "64");
+    parser.addOption(memoryLimitOption);
+    parser.process(app);
+
+    bool scaleIsValid;
+    bool repeatIsValid;
+    bool levelIsValid;
+    bool memoryLimitIsValid;
+    double scale = parser.value(scaleOption).toDouble(&scaleIsValid);
+    int repeat = parser.value(repeatOption).toInt(&repeatIsValid);
+    int level = parser.value(levelOption).toInt(&levelIsValid);
+    qint64 memoryLimit = parser.value(memoryLimitOption).toLongLong(&memoryLimitIsValid) * MiB;
+    QString scenarioName = parser.value(scenarioOption);
+    QString mode = parser.value(modeOption);
+    bool traced = parser.isSet(phasesOption);
+    QString ioBackendName = parser.value(ioBackendOption);
+    QString durabilityName = parser.value(durabilityOption);
+    if (!scaleIsValid || scale <= 0) {
+        qCritical("Invalid scale: %s", qPrintable(parser.value(scaleOption)));
+        return 1;
+    }
+    if (!repeatIsValid || repeat < 1) {
+        qCritical("Invalid repeat count: %s", qPrintable(parser.value(repeatOption)));
+        return 1;
+    }
+    if (!levelIsValid || level < 0 || level > 9) {
+        qCritical("Invalid compression level: %s", qPrintable(parser.value(levelOption)));
+        return 1;
+    }
+    if (!memoryLimitIsValid || memoryLimit < MiB) {
+        qCritical("Invalid memory limit: %s", qPrintable(parser.value(memoryLimitOption)));
+        return 1;
+    }
+    if (mode != "data" && mode != "payload" && mode != "both") {
+        qCritical("Invalid mode: %s", qPrintable(mode));
+        return 1;
+    }
+    if (ioBackendName != "qfile" && ioBackendName != "io_uring") {
+        qCritical("Invalid I/O backend: %s", qPrintable(ioBackendName));
+        return 1;
+    }
+    Installer::IoBackend ioBackend = ioBackendName == "io_uring" ? Installer::IoUringBackend : Installer::QFileBackend;
+    if (durabilityName != "none" && durabilityName != "batched" && durabilityName != "strict") {
+        qCritical("Invalid durability: %s", qPrintable(durabilityName));
+        return 1;
+    }
+    Installer::Durability durability = durabilityName == "none" ? Installer::NoSync : durabilityName == "strict" ? Installer::StrictSync : Installer::BatchedSync;
+
+    QTemporaryDir workDirectory(parser.value(workDirectoryOption) + "/sifbench-XXXXXX");
+    if (!workDirectory.isValid()) {
+        qCritical("Unable to create a work directory in \'%s\'", qPrintable(parser.value(workDirectoryOption)));
+        return 1;
+    }
+
+    bool scenarioFound = false;
+    for (auto scenario : scenarios(scale)) {
+        if (scenarioName != "all" && scenarioName != scenario.name) {
+            continue;
+        }
+        scenarioFound = true;
+
+        QString sourcePath = workDirectory.path() + '/' + scenario.name;
+        QString payloadPath = sourcePath + ".sif";
+        QString installationPath = workDirectory.path() + "/installation";
+        int fileCount;
+        qint64 totalSize;
+        qInfo("Generating the %s scenario", qPrintable(scenario.name));
+        if (!generateScenario(scenario, sourcePath, &fileCount, &totalSize)) {
+            return 1;
+        }
+
+        QStringList modes;
+        if (mode != "payload") {
+            modes << "data";
+        }
+        if (mode != "data") {
+            modes << "payload";
+        }
+        for (auto currentMode : modes) {
+            QJsonObject result;
+            result["scenario"] = scenario.name;
+            result["mode"] = currentMode;
+            result["ioBackend"] = ioBackendName;
+            result["durability"] = durabilityName;
+            result["memoryLimitMiB"] = memoryLimit / MiB;
+            result["files"] = fileCount;
+            result["bytes"] = totalSize;
+
+            if (currentMode == "payload") {
+                QElapsedTimer packClock;
+                packClock.start();
+                PayloadWriter writer(payloadPath, Payload::defaultChunkSize, level);
+                if (!writer.open() || !writer.addDirectory(sourcePath) || !writer.finish()) {
+                    qCritical("%s", qPrintable(writer.errorString()));
+                    return 1;
+                }
+                result["packMs"] = packClock.elapsed();
+                result["payloadBytes"] = QFileInfo(payloadPath).size();
+            }
+            // A payload that does not exist makes the installer walk the data directory
+            QString usedPayloadPath = currentMode == "payload" ? payloadPath : workDirectory.path() + "/missing.sif";
+
+            for (int iteration = 0; iteration < repeat; iteration++) {
+                result["iteration"] = iteration;
+
+                QDir(installationPath).removeRecursively();
+                resetPeakMemory();
+                IoCounters ioBefore = readIoCounters();
+                Run run = runInstaller(sourcePath, usedPayloadPath, installationPath, false, traced, ioBackend, durability, memoryLimit);
+                IoCounters ioAfter = readIoCounters();
+                if (!run.succeeded) {
+                    qCritical("Extraction failed: %s", qPrintable(run.errorString));
+                    return 1;
+                }
+                result["scanMs"] = run.scanTime;
+                result["extractMs"] = run.extractionTime;
+                result["totalMs"] = run.totalTime;
+                result["throughputMiBps"] = run.totalTime > 0 ? double(totalSize) / MiB / (run.totalTime / 1000.0) : 0;
+                result["readSyscalls"] = ioBefore.readCalls >= 0 ? QJsonValue(ioAfter.readCalls - ioBefore.readCalls) : QJsonValue();
+                result["writeSyscalls"] = ioBefore.writeCalls >= 0 ? QJsonValue(ioAfter.writeCalls - ioBefore.writeCalls) : QJsonValue();
+                qint64 peakResidentSize = peakMemory();
+                result["peakRssKiB"] = peakResidentSize >= 0 ? QJsonValue(peakResidentSize) : QJsonValue();
+                if (traced) {
+                    result["phases"] = QJsonObject::fromVariantMap(run.phases);
+                }
+
+                // Rollback is measured by canceling another extraction halfway. Fast extractions may finish first
+                QDir(installationPath).removeRecursively();
+                Run canceledRun = runInstaller(sourcePath, usedPayloadPath, installationPath, true, traced, ioBackend, durability, memoryLimit);
+                result["rollbackMs"] = canceledRun.reverted ? QJsonValue(canceledRun.rollbackTime) : QJsonValue();
+                if (traced && canceledRun.reverted) {
+                    result["canceledPhases"] = QJsonObject::fromVariantMap(canceledRun.phases);
+                }
+
+                print(result);
+            }
+            QDir(installationPath).removeRecursively();
+        }
+        QDir(sourcePath).removeRecursively();
+        QFile::remove(payloadPath);
+    }
+
+    if (!scenarioFound) {
+        qCritical("Unknown scenario: %s", qPrintable(scenarioName));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#--------------------------------------------------#
+#                                                  #
+# SIF: Simple Installer Framework                  #
+# Simply, an alternative to Qt Installer Framework #
+#                                                  #
+# Copyright © 2019 Simelo.Tech                        #
+#                                                  #
+# This project is under the GPLv3 license          #
+#                                                  #
+#--------------------------------------------------#
+
+# Measures the extraction pipeline on synthetic payloads
+
+QT -= gui
+QT += concurrent
+
+TARGET = sifbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../SimpleInstallerFramework.pri)
+
+SOURCES += \
+        main.cpp
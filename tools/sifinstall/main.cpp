@@ -0,0 +1,249 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaEnum>
+#include <QThreadPool>
+#include <QTimer>
+#include <csignal>
+#include <cstdio>
+
+#include "installer.h"
+
+namespace {
+// Exit codes, see README.md
+const int exitSuccess = 0;
+const int exitInvalidArguments = 1;
+const int exitCanceled = 2;
+const int exitReversionFailed = 3;
+const int exitSuspended = 4;
+const int exitPathErrorBase = 10; // + Installer::InstallationPathError
+const int exitFileErrorBase = 20; // + QFile::FileError
+
+const qint64 MiB = 1024 * 1024;
+const int cancelPollInterval = 100; // ms
+
+const char *const fileErrorNames[] = { "NoError", "ReadError", "WriteError", "FatalError", "ResourceError", "OpenError", "AbortError",
+                                       "TimeOutError", "UnspecifiedError", "RemoveError", "RenameError", "PositionError", "ResizeError",
+                                       "PermissionsError", "CopyError" };
+
+volatile std::sig_atomic_t cancelRequested = 0;
+
+void requestCancel(int)
+{
+    cancelRequested = 1;
+}
+
+template <typename Enum>
+QString enumName(Enum value)
+{
+    return QMetaEnum::fromType<Enum>().valueToKey(value);
+}
+
+QString fileErrorName(QFile::FileError error)
+{
+    return error >= 0 && size_t(error) < sizeof(fileErrorNames) / sizeof(fileErrorNames[0]) ? fileErrorNames[error] : "UnspecifiedError";
+}
+
+// Events are printed as JSON lines on stdout, unless silent
+class EventPrinter
+{
+public:
+    explicit EventPrinter(bool silent) : silent(silent)
+    {
+    }
+
+    void print(const QString &event, QJsonObject fields) const
+    {
+        if (silent) {
+            return;
+        }
+        fields["event"] = event;
+        QByteArray line = QJsonDocument(fields).toJson(QJsonDocument::Compact);
+        fprintf(stdout, "%s\n", line.constData());
+        fflush(stdout);
+    }
+
+private:
+    bool silent;
+};
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sifinstall");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Installs an application without user interaction, reporting its progress as JSON lines");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption silentOption(QStringList() << "s" << "silent", "Prints no events, only errors on stderr. The exit code tells the result.");
+    QCommandLineOption payloadOption(QStringList() << "p" << "payload", "SIF payload to install (the one in the resources by default).", "file");
+    QCommandLineOption dataOption(QStringList() << "d" << "data", "Directory to install when there is no payload (the one in the resources by default).", "directory");
+    QCommandLineOption updateOption(QStringList() << "u" << "update", "Updates an existing installation.");
+    QCommandLineOption transactionalOption(QStringList() << "t" << "transactional", "Installs everything or nothing.");
+    QCommandLineOption resumableOption(QStringList() << "r" << "resumable", "Keeps a checkpoint, so an interrupted installation continues where it stopped when run again.");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Files extracted at the same time (the number of CPU cores by default).", "count");
+    QCommandLineOption durabilityOption("durability", "How installed files are flushed to disk: none, batched or strict (batched by default).", "mode", "batched");
+    QCommandLineOption ioBackendOption("io-backend", "How payload files are written: qfile or io_uring (qfile by default).", "backend", "qfile");
+    QCommandLineOption memoryLimitOption("memory-limit", "Memory used for I/O buffers, in MiB (64 by default).", "MiB", "64");
+    QCommandLineOption progressIntervalOption("progress-interval", "Interval between progress events, in milliseconds (500 by default). 0 only reports them when a phase starts or ends.", "ms", "500");
+    parser.addOption(silentOption);
+    parser.addOption(payloadOption);
+    parser.addOption(dataOption);
+    parser.addOption(updateOption);
+    parser.addOption(transactionalOption);
+    parser.addOption(resumableOption);
+    parser.addOption(jobsOption);
+    parser.addOption(durabilityOption);
+    parser.addOption(ioBackendOption);
+    parser.addOption(memoryLimitOption);
+    parser.addOption(progressIntervalOption);
+    parser.addPositionalArgument("path", "Absolute installation path");
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 1) {
+        parser.showHelp(exitInvalidArguments);
+    }
+
+    bool jobsIsValid = true;
+    bool memoryLimitIsValid;
+    bool progressIntervalIsValid;
+    int jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt(&jobsIsValid) : QThread::idealThreadCount();
+    qint64 memoryLimit = parser.value(memoryLimitOption).toLongLong(&memoryLimitIsValid) * MiB;
+    int progressInterval = parser.value(progressIntervalOption).toInt(&progressIntervalIsValid);
+    QString durabilityName = parser.value(durabilityOption);
+    QString ioBackendName = parser.value(ioBackendOption);
+    if (!jobsIsValid || jobs < 1) {
+        qCritical("Invalid number of jobs: %s", qPrintable(parser.value(jobsOption)));
+        return exitInvalidArguments;
+    }
+    if (!memoryLimitIsValid || memoryLimit < MiB) {
+        qCritical("Invalid memory limit: %s", qPrintable(parser.value(memoryLimitOption)));
+        return exitInvalidArguments;
+    }
+    if (!progressIntervalIsValid || progressInterval < 0) {
+        qCritical("Invalid progress interval: %s", qPrintable(parser.value(progressIntervalOption)));
+        return exitInvalidArguments;
+    }
+    if (durabilityName != "none" && durabilityName != "batched" && durabilityName != "strict") {
+        qCritical("Invalid durability: %s", qPrintable(durabilityName));
+        return exitInvalidArguments;
+    }
+    if (ioBackendName != "qfile" && ioBackendName != "io_uring") {
+        qCritical("Invalid I/O backend: %s", qPrintable(ioBackendName));
+        return exitInvalidArguments;
+    }
+
+    Installer installer;
+    if (parser.isSet(payloadOption)) {
+        installer.setPayloadPath(parser.value(payloadOption));
+    }
+    if (parser.isSet(dataOption)) {
+        installer.setDataPath(parser.value(dataOption));
+    }
+    installer.setUpdateMode(parser.isSet(updateOption));
+    installer.setTransactional(parser.isSet(transactionalOption));
+    installer.setResumable(parser.isSet(resumableOption));
+    installer.setMaxConcurrentExtractions(jobs);
+    installer.setDurability(durabilityName == "none" ? Installer::NoSync : durabilityName == "strict" ? Installer::StrictSync : Installer::BatchedSync);
+    installer.setIoBackend(ioBackendName == "io_uring" ? Installer::IoUringBackend : Installer::QFileBackend);
+    installer.setMemoryLimit(memoryLimit);
+    installer.setProgressInterval(progressInterval);
+    installer.setInstallationPath(QDir::cleanPath(arguments.at(0)));
+
+    EventPrinter printer(parser.isSet(silentOption));
+    if (!installer.getInstallationPathIsValid()) {
+        Installer::InstallationPathError error = installer.getInstallationPathError();
+        qCritical("Invalid installation path \'%s\': %s", qPrintable(arguments.at(0)), qPrintable(installer.getInstallationPathErrorString()));
+        printer.print("error", { { "error", enumName(error) }, { "message", installer.getInstallationPathErrorString() } });
+        return exitPathErrorBase + error;
+    }
+
+    // Progress and results are handled by the main thread, the installer reports them from its workers
+    int exitCode = exitSuccess;
+    bool failed = false;
+    QElapsedTimer clock;
+    QObject::connect(&installer, &Installer::installerStatusChanged, &app, [&](Installer::InstallerStatus status) {
+        printer.print("status", { { "status", enumName(status) } });
+        if (status == Installer::ExtractionFinished || status == Installer::ExtractionCanceled || status == Installer::ErrorOccurred
+            || status == Installer::ExtractionSuspended) {
+            if (status == Installer::ExtractionCanceled && exitCode == exitSuccess) {
+                exitCode = exitCanceled;
+            } else if (status == Installer::ExtractionSuspended) {
+                exitCode = exitSuspended;
+            }
+            failed = status == Installer::ErrorOccurred;
+            QMetaObject::invokeMethod(&app, "quit", Qt::QueuedConnection); // after the error, if any
+        }
+    }, Qt::QueuedConnection);
+    QObject::connect(&installer, &Installer::progressReported, &app, [&](double progress) {
+        printer.print("progress", { { "status", enumName(installer.getInstallerStatus()) },
+                                    { "progress", progress },
+                                    { "extractedFiles", installer.getExtractedFileCount() },
+                                    { "totalFiles", installer.getTotalFileCount() },
+                                    { "totalBytes", installer.getTotalSize() },
+                                    { "throughput", installer.getThroughput() },
+                                    { "remainingMs", installer.getRemainingTime() } });
+    });
+    QObject::connect(&installer, &Installer::extractionError, &app, [&](QFile::FileError error, const QString &errorString) {
+        qCritical("%s", qPrintable(errorString));
+        printer.print("error", { { "error", fileErrorName(error) }, { "message", errorString } });
+        if (exitCode == exitSuccess) {
+            exitCode = exitFileErrorBase + error;
+        }
+    }, Qt::QueuedConnection);
+    QObject::connect(&installer, &Installer::reversionFailed, &app, [&]() {
+        qCritical("Unable to revert the installation");
+        printer.print("error", { { "error", "ReversionFailed" }, { "message", "Unable to revert the installation" } });
+        exitCode = exitReversionFailed;
+    }, Qt::QueuedConnection);
+
+    // Interrupted installations are reverted before leaving, or suspended if they can be resumed
+    std::signal(SIGINT, requestCancel);
+    std::signal(SIGTERM, requestCancel);
+    QTimer cancelTimer;
+    QObject::connect(&cancelTimer, &QTimer::timeout, [&]() {
+        if (cancelRequested) {
+            cancelTimer.stop();
+            bool suspendable = parser.isSet(resumableOption) && !parser.isSet(transactionalOption)
+                               && (installer.getInstallerStatus() == Installer::FetchingFiles || installer.getInstallerStatus() == Installer::ExtractingPackages);
+            if (suspendable) {
+                installer.suspend();
+            } else {
+                exitCode = exitCanceled;
+                installer.cancel();
+            }
+        }
+    });
+    cancelTimer.start(cancelPollInterval);
+
+    clock.start();
+    installer.extractAll();
+    app.exec();
+    QThreadPool::globalInstance()->waitForDone(); // the extraction may still be leaving after an error
+    if (failed && exitCode == exitSuccess) {
+        exitCode = exitFileErrorBase + QFile::UnspecifiedError;
+    }
+
+    printer.print("finished", { { "status", enumName(installer.getInstallerStatus()) },
+                                { "extractedFiles", installer.getExtractedFileCount() },
+                                { "totalBytes", installer.getTotalSize() },
+                                { "elapsedMs", clock.elapsed() },
+                                { "exitCode", exitCode } });
+    return exitCode;
+}
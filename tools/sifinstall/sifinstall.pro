@@ -0,0 +1,30 @@
+#--------------------------------------------------#
+#                                                  #
+# SIF: Simple Installer Framework                  #
+# Simply, an alternative to Qt Installer Framework #
+#                                                  #
+# Copyright © 2019 Simelo.Tech                        #
+#                                                  #
+# This project is under the GPLv3 license          #
+#                                                  #
+#--------------------------------------------------#
+
+# Installs without a GUI, for scripts and provisioning pipelines
+
+QT -= gui
+QT += concurrent
+
+TARGET = sifinstall
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../SimpleInstallerFramework.pri)
+
+# The data to install is taken from the resources, like in any other installer:
+# RESOURCES += ../../resources/unix/data.qrc
+
+SOURCES += \
+        main.cpp
@@ -0,0 +1,87 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "payload.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sifpack");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Packs a directory tree into a SIF payload");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption chunkSizeOption(QStringList() << "c" << "chunk-size", "Size of the independently compressed chunks, in KiB (1024 by default).", "KiB", "1024");
+    QCommandLineOption levelOption(QStringList() << "l" << "level", "Compression level, from 0 (store only) to 9 (9 by default).", "level", "9");
+    QCommandLineOption packSizeOption(QStringList() << "p" << "pack-size", "Largest file packed together with other small files, in KiB (16 by default). 0 disables packing.", "KiB", "16");
+    QCommandLineOption baseOption(QStringList() << "b" << "base", "Previous version of the source directory. Changed files are stored as deltas against it, so the payload can only update that version.", "directory");
+    QCommandLineOption noDeduplicationOption("no-dedup", "Stores every file, even if another one has the same contents.");
+    parser.addOption(chunkSizeOption);
+    parser.addOption(levelOption);
+    parser.addOption(packSizeOption);
+    parser.addOption(baseOption);
+    parser.addOption(noDeduplicationOption);
+    parser.addPositionalArgument("source", "Directory to pack, e.g. resources/unix/data");
+    parser.addPositionalArgument("payload", "Payload to create, e.g. resources/unix/data.sif");
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    bool chunkSizeIsValid;
+    bool levelIsValid;
+    bool packSizeIsValid;
+    qint64 chunkSize = parser.value(chunkSizeOption).toLongLong(&chunkSizeIsValid) * 1024;
+    int level = parser.value(levelOption).toInt(&levelIsValid);
+    qint64 maxPackedFileSize = parser.value(packSizeOption).toLongLong(&packSizeIsValid) * 1024;
+    if (!chunkSizeIsValid || chunkSize <= 0) {
+        qCritical("Invalid chunk size: %s", qPrintable(parser.value(chunkSizeOption)));
+        return 1;
+    }
+    if (!levelIsValid || level < 0 || level > 9) {
+        qCritical("Invalid compression level: %s", qPrintable(parser.value(levelOption)));
+        return 1;
+    }
+
+    if (!packSizeIsValid || maxPackedFileSize < 0) {
+        qCritical("Invalid pack size: %s", qPrintable(parser.value(packSizeOption)));
+        return 1;
+    }
+
+    PayloadWriter writer(arguments.at(1), chunkSize, level, maxPackedFileSize, !parser.isSet(noDeduplicationOption));
+    if (!writer.open() || !writer.addDirectory(arguments.at(0), parser.value(baseOption)) || !writer.finish()) {
+        qCritical("%s", qPrintable(writer.errorString()));
+        return 1;
+    }
+
+    qint64 totalSize = 0;
+    int deltaCount = 0;
+    int packedCount = 0;
+    int duplicateCount = 0;
+    qint64 duplicateSize = 0;
+    for (auto entry : writer.entries()) {
+        totalSize += entry.size;
+        deltaCount += entry.type == Payload::Delta ? 1 : 0;
+        packedCount += entry.pack >= 0 ? 1 : 0;
+        if (entry.type == Payload::Duplicate) {
+            duplicateCount++;
+            duplicateSize += entry.size;
+        }
+    }
+    qInfo("Packed %d files (%lld bytes, %d deltas, %d small files in %d packs, %d duplicates of %lld bytes stored once) into \'%s\'",
+          writer.entries().size(), totalSize, deltaCount, packedCount, writer.packs().size(), duplicateCount, duplicateSize, qPrintable(arguments.at(1)));
+    return 0;
+}
@@ -0,0 +1,35 @@
+#--------------------------------------------------#
+#                                                  #
+# SIF: Simple Installer Framework                  #
+# Simply, an alternative to Qt Installer Framework #
+#                                                  #
+# Copyright © 2019 Simelo.Tech                        #
+#                                                  #
+# This project is under the GPLv3 license          #
+#                                                  #
+#--------------------------------------------------#
+
+# Packs a directory tree into a SIF payload at build time
+
+QT -= gui
+
+TARGET = sifpack
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SIF_ROOT = $$PWD/../..
+INCLUDEPATH += $$SIF_ROOT
+
+SOURCES += \
+        main.cpp \
+        $$SIF_ROOT/checksum.cpp \
+        $$SIF_ROOT/delta.cpp \
+        $$SIF_ROOT/payload.cpp
+
+HEADERS += \
+        $$SIF_ROOT/checksum.h \
+        $$SIF_ROOT/delta.h \
+        $$SIF_ROOT/payload.h
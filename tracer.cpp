@@ -0,0 +1,176 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#include "tracer.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace {
+const char *const phaseNames[Tracer::PhaseCount] = { "scan", "mkdir", "open", "copy", "fsync", "permissions", "rollback" };
+
+// File being extracted by the current thread
+struct ThreadState {
+    const Tracer *tracer = nullptr;
+    bool sampled = false;
+    QString file;
+};
+
+thread_local ThreadState threadState;
+thread_local int threadId = 0;
+QAtomicInt nextThreadId = 1;
+
+int currentThreadId() // small and stable ids read better in trace viewers than native ones
+{
+    if (threadId == 0) {
+        threadId = nextThreadId.fetchAndAddRelaxed(1);
+    }
+    return threadId;
+}
+}
+
+//! Tracer::Scope
+
+Tracer::Scope::Scope(Tracer &tracer, Phase phase, const QString &detail) : tracer(tracer), phase(phase), detail(detail)
+{
+    if (tracer.enabled) {
+        start = tracer.clock.nsecsElapsed();
+    }
+}
+
+Tracer::Scope::~Scope()
+{
+    stop();
+}
+
+void Tracer::Scope::stop()
+{
+    if (start >= 0) {
+        tracer.record(phase, start, detail);
+        start = -1;
+    }
+}
+
+//! Tracer::FileScope
+
+Tracer::FileScope::FileScope(Tracer &tracer, const QString &path)
+{
+    tracer.beginFile(path);
+}
+
+Tracer::FileScope::~FileScope()
+{
+    threadState.tracer = nullptr;
+    threadState.sampled = false;
+    threadState.file.clear();
+}
+
+//! Tracer
+
+void Tracer::reset(bool value, int interval)
+{
+    QMutexLocker locker(&eventsMutex);
+    enabled = value;
+    samplingInterval = qMax(1, interval);
+    for (int phase = 0; phase < PhaseCount; phase++) {
+        phaseCounts[phase].storeRelease(0);
+        phaseDurations[phase].storeRelease(0);
+    }
+    fileCount.storeRelease(0);
+    events.clear();
+    clock.start();
+}
+
+bool Tracer::isEnabled() const
+{
+    return enabled;
+}
+
+void Tracer::beginFile(const QString &path)
+{
+    if (!enabled) {
+        return;
+    }
+    threadState.tracer = this;
+    threadState.sampled = fileCount.fetchAndAddRelaxed(1) % samplingInterval == 0;
+    threadState.file = threadState.sampled ? path : QString();
+}
+
+QVariantMap Tracer::summary() const
+{
+    QVariantMap phases;
+    for (int phase = 0; phase < PhaseCount; phase++) {
+        qint64 count = phaseCounts[phase].loadAcquire();
+        qint64 duration = phaseDurations[phase].loadAcquire();
+        QVariantMap phaseSummary;
+        phaseSummary["count"] = count;
+        phaseSummary["totalMs"] = duration / 1e6;
+        phaseSummary["averageUs"] = count > 0 ? duration / 1e3 / count : 0;
+        phases[phaseName(Phase(phase))] = phaseSummary;
+    }
+    return phases;
+}
+
+bool Tracer::writeChromeTrace(const QString &filePath, QString *errorString) const
+{
+    QJsonArray traceEvents;
+    {
+        QMutexLocker locker(&eventsMutex);
+        for (auto event : events) {
+            QJsonObject traceEvent;
+            traceEvent["name"] = phaseName(event.phase);
+            traceEvent["cat"] = "sif";
+            traceEvent["ph"] = "X"; // complete event, with its duration
+            traceEvent["ts"] = event.start / 1e3; // µs
+            traceEvent["dur"] = event.duration / 1e3;
+            traceEvent["pid"] = 1;
+            traceEvent["tid"] = event.thread;
+            if (!event.detail.isEmpty()) {
+                traceEvent["args"] = QJsonObject { { "path", event.detail } };
+            }
+            traceEvents.append(traceEvent);
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString Tracer::phaseName(Phase phase)
+{
+    return phaseNames[phase];
+}
+
+void Tracer::record(Phase phase, qint64 start, const QString &detail)
+{
+    qint64 duration = clock.nsecsElapsed() - start;
+    phaseCounts[phase].fetchAndAddRelaxed(1);
+    phaseDurations[phase].fetchAndAddRelaxed(duration);
+
+    // Events out of a file (e.g. syncing the installation) are always kept, events of files only if the file is sampled
+    bool inFile = threadState.tracer == this;
+    if (inFile && !threadState.sampled) {
+        return;
+    }
+    Event event { phase, currentThreadId(), start, duration, detail.isEmpty() && inFile ? threadState.file : detail };
+    QMutexLocker locker(&eventsMutex);
+    if (events.size() < maxEventCount) {
+        events.append(event);
+    }
+}
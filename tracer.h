@@ -0,0 +1,86 @@
+/*****************************************************
+ * SIF: Simple Installer Framework                   *
+ * Simply, an alternative to Qt Installer Framework  *
+ *                                                   *
+ * Copyright © 2019 Simelo.Tech                         *
+ *                                                   *
+ * This project is under the GPLv3 license           *
+ *****************************************************/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+// Records how long every phase of an installation takes. The time and count of every phase are always accumulated,
+// while single events are only kept for one out of every `samplingInterval` files, so a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) can be exported without slowing down installations of many small files.
+// Thread-safe. Does nothing while disabled.
+class Tracer
+{
+public:
+    enum Phase { Scan, MakeDirectory, Open, Copy, Sync, SetPermissions, Rollback, PhaseCount };
+
+    // Times the enclosing block
+    class Scope
+    {
+    public:
+        Scope(Tracer &tracer, Phase phase, const QString &detail = QString());
+        ~Scope();
+
+        void stop(); // ends the phase before the end of the block
+
+    private:
+        Tracer &tracer;
+        Phase phase;
+        QString detail;
+        qint64 start = -1;
+    };
+
+    // Marks the file (or directory) handled by the current thread during the enclosing block. Its events are only kept
+    // if it is sampled
+    class FileScope
+    {
+    public:
+        FileScope(Tracer &tracer, const QString &path);
+        ~FileScope();
+    };
+
+    static const int maxEventCount = 1000000;
+
+    void reset(bool enabled, int samplingInterval);
+    bool isEnabled() const;
+
+    QVariantMap summary() const; // phase name -> count, total time (ms) and average time (µs)
+    bool writeChromeTrace(const QString &filePath, QString *errorString) const;
+
+    static QString phaseName(Phase phase);
+
+private:
+    struct Event {
+        Phase phase;
+        int thread;
+        qint64 start; // ns since reset()
+        qint64 duration; // ns
+        QString detail;
+    };
+
+    bool enabled = false;
+    int samplingInterval = 1;
+    QElapsedTimer clock;
+    QAtomicInteger<qint64> phaseCounts[PhaseCount];
+    QAtomicInteger<qint64> phaseDurations[PhaseCount]; // ns
+    QAtomicInt fileCount = 0;
+    mutable QMutex eventsMutex; // guards events
+    QVector<Event> events;
+
+    void beginFile(const QString &path);
+    void record(Phase phase, qint64 start, const QString &detail);
+};
+
+#endif // TRACER_H